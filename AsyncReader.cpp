@@ -0,0 +1,314 @@
+#include "AsyncReader.h"
+#include "FileReader.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef BAYAN_POSIX_IO
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define BAYAN_HAVE_IO_URING 1
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#endif
+
+namespace {
+
+#ifdef BAYAN_POSIX_IO
+    // Блокирующее чтение запроса целиком (с повтором коротких чтений)
+    size_t read_fully(const AsyncReader::Request& request, size_t done) {
+        while (done < request.length) {
+            ssize_t got = ::pread(request.fd, request.buffer + done, request.length - done,
+                                  static_cast<off_t>(request.offset + done));
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got <= 0) {
+                break;
+            }
+            done += static_cast<size_t>(got);
+        }
+        return done;
+    }
+
+    // Запасной вариант: вспомогательные потоки с блокирующими pread.
+    // epoll для обычных файлов не работает, поэтому глубина очереди - число потоков.
+    class ThreadReader : public AsyncReader {
+    private:
+        ThreadPool pool_;
+
+    public:
+        explicit ThreadReader(size_t queue_depth) : pool_(std::min<size_t>(queue_depth, 32)) {}
+
+        const char* name() const override { return "threads"; }
+
+        void run(const std::vector<Request>& requests, const Completion& on_complete) override {
+            for (size_t i = 0; i < requests.size(); ++i) {
+                pool_.submit([&requests, &on_complete, i]() {
+                    on_complete(i, read_fully(requests[i], 0));
+                });
+            }
+            pool_.wait();
+        }
+    };
+#endif
+
+#ifdef BAYAN_HAVE_IO_URING
+    // io_uring без liburing: кольца отображаются напрямую, запросы - IORING_OP_READV
+    class UringReader : public AsyncReader {
+    private:
+        int ring_fd_;
+        size_t depth_;
+        void* sq_ring_;
+        size_t sq_ring_size_;
+        void* cq_ring_;
+        size_t cq_ring_size_;
+        io_uring_sqe* sqes_;
+        size_t sqes_size_;
+
+        unsigned* sq_head_;
+        unsigned* sq_tail_;
+        unsigned sq_mask_;
+        unsigned sq_entries_;
+        unsigned* sq_array_;
+        unsigned* cq_head_;
+        unsigned* cq_tail_;
+        unsigned cq_mask_;
+        io_uring_cqe* cqes_;
+
+        UringReader() : ring_fd_(-1), depth_(0), sq_ring_(MAP_FAILED), sq_ring_size_(0),
+                        cq_ring_(MAP_FAILED), cq_ring_size_(0), sqes_(nullptr), sqes_size_(0),
+                        sq_head_(nullptr), sq_tail_(nullptr), sq_mask_(0), sq_entries_(0),
+                        sq_array_(nullptr), cq_head_(nullptr), cq_tail_(nullptr), cq_mask_(0),
+                        cqes_(nullptr) {}
+
+        static void* map_ring(int fd, size_t size, off_t offset) {
+            return ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+        }
+
+        bool setup(size_t queue_depth) {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            long fd = ::syscall(__NR_io_uring_setup, static_cast<unsigned>(queue_depth), &params);
+            if (fd < 0) {
+                return false;
+            }
+            ring_fd_ = static_cast<int>(fd);
+
+            sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+            }
+
+            sq_ring_ = map_ring(ring_fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+            if (sq_ring_ == MAP_FAILED) {
+                return false;
+            }
+            if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                cq_ring_ = sq_ring_;
+            } else {
+                cq_ring_ = map_ring(ring_fd_, cq_ring_size_, IORING_OFF_CQ_RING);
+                if (cq_ring_ == MAP_FAILED) {
+                    return false;
+                }
+            }
+            sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+            void* sqes = map_ring(ring_fd_, sqes_size_, IORING_OFF_SQES);
+            if (sqes == MAP_FAILED) {
+                return false;
+            }
+            sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+            char* sq = static_cast<char*>(sq_ring_);
+            sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sq_entries_ = params.sq_entries;
+            sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+            char* cq = static_cast<char*>(cq_ring_);
+            cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+            depth_ = params.sq_entries;
+            return true;
+        }
+
+        int enter(unsigned to_submit, unsigned min_complete) {
+            return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete,
+                                              IORING_ENTER_GETEVENTS, nullptr, 0));
+        }
+
+    public:
+        ~UringReader() override {
+            if (sqes_) {
+                ::munmap(sqes_, sqes_size_);
+            }
+            if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+                ::munmap(cq_ring_, cq_ring_size_);
+            }
+            if (sq_ring_ != MAP_FAILED) {
+                ::munmap(sq_ring_, sq_ring_size_);
+            }
+            if (ring_fd_ >= 0) {
+                ::close(ring_fd_);
+            }
+        }
+
+        static std::unique_ptr<UringReader> try_create(size_t queue_depth) {
+            std::unique_ptr<UringReader> reader(new UringReader());
+            if (!reader->setup(queue_depth)) {
+                return nullptr;
+            }
+            return reader;
+        }
+
+        const char* name() const override { return "uring"; }
+
+        void run(const std::vector<Request>& requests, const Completion& on_complete) override {
+            std::vector<size_t> done(requests.size(), 0);
+            std::vector<iovec> iovecs(requests.size());
+            std::vector<size_t> slot_request(sq_entries_);  // Какой запрос лежит в слоте SQ
+            std::vector<size_t> ready;                      // Запросы к отправке (новые и дочитывание)
+            ready.reserve(requests.size());
+            for (size_t i = requests.size(); i > 0; --i) {
+                ready.push_back(i - 1);
+            }
+
+            size_t in_flight = 0;
+            size_t completed = 0;
+            while (completed < requests.size()) {
+                // Заполняем очередь отправки; без SQPOLL ядро забирает записи
+                // только в io_uring_enter, поэтому head здесь не сдвигается
+                unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+                unsigned tail = *sq_tail_;
+                while (!ready.empty() && in_flight < depth_ && tail - head < sq_entries_) {
+                    size_t index = ready.back();
+                    ready.pop_back();
+                    const Request& request = requests[index];
+                    iovecs[index].iov_base = request.buffer + done[index];
+                    iovecs[index].iov_len = request.length - done[index];
+
+                    unsigned slot = tail & sq_mask_;
+                    io_uring_sqe* sqe = &sqes_[slot];
+                    std::memset(sqe, 0, sizeof(*sqe));
+                    sqe->opcode = IORING_OP_READV;
+                    sqe->fd = request.fd;
+                    sqe->off = request.offset + done[index];
+                    sqe->addr = reinterpret_cast<uintptr_t>(&iovecs[index]);
+                    sqe->len = 1;
+                    sqe->user_data = index;
+                    sq_array_[slot] = slot;
+                    slot_request[slot] = index;
+                    ++tail;
+                    ++in_flight;
+                }
+                __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+                if (enter(tail - head, in_flight > 0 ? 1 : 0) < 0 &&
+                    errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    // Кольцо неработоспособно: неотправленное читаем синхронно
+                    unsigned consumed = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+                    for (unsigned pos = consumed; pos != tail; ++pos) {
+                        size_t index = slot_request[pos & sq_mask_];
+                        on_complete(index, read_fully(requests[index], done[index]));
+                        ++completed;
+                        --in_flight;
+                    }
+                    __atomic_store_n(sq_tail_, consumed, __ATOMIC_RELEASE);
+                    while (!ready.empty()) {
+                        size_t index = ready.back();
+                        ready.pop_back();
+                        on_complete(index, read_fully(requests[index], done[index]));
+                        ++completed;
+                    }
+                    if (in_flight > 0 && enter(0, static_cast<unsigned>(in_flight)) < 0 &&
+                        errno != EINTR) {
+                        throw std::runtime_error("io_uring_enter failed");
+                    }
+                }
+
+                // Разбираем завершения
+                unsigned cq_head = *cq_head_;
+                unsigned cq_tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+                while (cq_head != cq_tail) {
+                    const io_uring_cqe& cqe = cqes_[cq_head & cq_mask_];
+                    size_t index = static_cast<size_t>(cqe.user_data);
+                    int res = cqe.res;
+                    ++cq_head;
+                    --in_flight;
+
+                    if (res == -EINTR || res == -EAGAIN) {
+                        ready.push_back(index);
+                        continue;
+                    }
+                    if (res > 0) {
+                        done[index] += static_cast<size_t>(res);
+                        if (done[index] < requests[index].length) {
+                            ready.push_back(index);  // Короткое чтение - дочитываем
+                            continue;
+                        }
+                    }
+                    on_complete(index, done[index]);
+                    ++completed;
+                }
+                __atomic_store_n(cq_head_, cq_head, __ATOMIC_RELEASE);
+            }
+        }
+    };
+#endif
+}
+
+std::unique_ptr<AsyncReader> AsyncReader::create(AsyncEngine engine, size_t queue_depth) {
+    if (engine == AsyncEngine::none) {
+        return nullptr;
+    }
+    queue_depth = std::max<size_t>(queue_depth, 1);
+#ifdef BAYAN_HAVE_IO_URING
+    if (engine == AsyncEngine::uring || engine == AsyncEngine::automatic) {
+        std::unique_ptr<UringReader> uring = UringReader::try_create(queue_depth);
+        if (uring) {
+            return uring;
+        }
+        if (engine == AsyncEngine::uring) {
+            throw std::runtime_error("io_uring is not available");
+        }
+    }
+#else
+    if (engine == AsyncEngine::uring) {
+        throw std::runtime_error("io_uring is not supported on this platform");
+    }
+#endif
+#ifdef BAYAN_POSIX_IO
+    return std::make_unique<ThreadReader>(queue_depth);
+#else
+    return nullptr;
+#endif
+}
+
+AsyncEngine AsyncReader::parse_engine(const std::string& name) {
+    if (name == "none") {
+        return AsyncEngine::none;
+    }
+    if (name == "threads") {
+        return AsyncEngine::threads;
+    }
+    if (name == "uring") {
+        return AsyncEngine::uring;
+    }
+    if (name == "auto") {
+        return AsyncEngine::automatic;
+    }
+    throw std::invalid_argument("Unknown async engine: " + name);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Механизм асинхронного чтения блоков
+enum class AsyncEngine {
+    none,       // Синхронное чтение по одному файлу
+    threads,    // Вспомогательные потоки с блокирующими pread
+    uring,      // io_uring (Linux)
+    automatic   // io_uring, если ядро его поддерживает, иначе потоки
+};
+
+// Пакетное чтение: держит в полёте до queue_depth запросов к разным файлам.
+// Экземпляр принадлежит одному потоку-обработчику.
+class AsyncReader {
+public:
+    struct Request {
+        int fd;
+        uintmax_t offset;
+        size_t length;
+        char* buffer;
+    };
+
+    // Вызывается для каждого завершённого запроса: индекс в векторе запросов
+    // и число прочитанных байт (меньше length - ошибка или конец файла).
+    // Может вызываться из вспомогательных потоков, но не одновременно для
+    // одного и того же запроса.
+    using Completion = std::function<void(size_t index, size_t bytes)>;
+
+    virtual ~AsyncReader() = default;
+
+    virtual const char* name() const = 0;
+
+    // Выполнить все запросы и дождаться их завершения
+    virtual void run(const std::vector<Request>& requests, const Completion& on_complete) = 0;
+
+    // Создать механизм; automatic выбирает io_uring при поддержке ядром.
+    // Для none возвращает nullptr.
+    static std::unique_ptr<AsyncReader> create(AsyncEngine engine, size_t queue_depth);
+
+    // Разобрать значение --async; неизвестное значение - std::invalid_argument
+    static AsyncEngine parse_engine(const std::string& name);
+};
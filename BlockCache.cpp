@@ -0,0 +1,376 @@
+#include "BlockCache.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifdef BAYAN_POSIX_IO
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const char cache_magic[8] = {'B', 'A', 'Y', 'A', 'N', 'B', 'C', '1'};
+    const uint32_t cache_version = 3;
+    const size_t algorithm_field_size = 16;
+
+    // Запись индекса на диске: только 8-байтовые поля, без выравнивания.
+    // По смещению offset лежат prefix хешей префикса, затем scattered
+    // номеров отдельных блоков (uint64) и их хеши.
+    struct IndexRecord {
+        uint64_t device;
+        uint64_t inode;
+        uint64_t size;
+        int64_t mtime;
+        uint64_t offset;
+        uint64_t prefix;
+        uint64_t scattered;
+    };
+
+    template <typename T>
+    void write_value(std::ostream& out, const T& value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+}
+
+BlockCache::BlockCache(const boost::filesystem::path& cache_path, size_t block_size,
+                       const std::string& algorithm, size_t digest_size)
+    : cache_path_(cache_path), block_size_(block_size), algorithm_(algorithm),
+      digest_size_(digest_size) {
+#ifdef BAYAN_POSIX_IO
+    stored_fd_ = -1;
+#endif
+}
+
+BlockCache::~BlockCache() {
+    close_stored();
+}
+
+bool BlockCache::stored_open() const {
+#ifdef BAYAN_POSIX_IO
+    return stored_fd_ >= 0;
+#else
+    return stored_.is_open();
+#endif
+}
+
+void BlockCache::close_stored() {
+#ifdef BAYAN_POSIX_IO
+    if (stored_fd_ >= 0) {
+        ::close(stored_fd_);
+        stored_fd_ = -1;
+    }
+#else
+    stored_.close();
+#endif
+}
+
+bool BlockCache::read_stored(uint64_t offset, void* buffer, size_t length) {
+    char* out = static_cast<char*>(buffer);
+#ifdef BAYAN_POSIX_IO
+    size_t total = 0;
+    while (total < length) {
+        ssize_t got = ::pread(stored_fd_, out + total, length - total,
+                              static_cast<off_t>(offset + total));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        total += static_cast<size_t>(got);
+    }
+    return true;
+#else
+    std::lock_guard<std::mutex> lock(stored_mutex_);
+    stored_.clear();
+    stored_.seekg(static_cast<std::streamoff>(offset));
+    stored_.read(out, static_cast<std::streamsize>(length));
+    return static_cast<bool>(stored_);
+#endif
+}
+
+void BlockCache::load() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    close_stored();
+
+#ifdef BAYAN_POSIX_IO
+    stored_fd_ = ::open(cache_path_.c_str(), O_RDONLY);
+#else
+    stored_.open(cache_path_.string(), std::ios::binary);
+#endif
+    if (!stored_open()) {
+        return;  // Первый запуск - кэша ещё нет
+    }
+
+    // Размер файла ограничивает все смещения и счётчики из него
+    uint64_t file_size = 0;
+#ifdef BAYAN_POSIX_IO
+    struct stat info;
+    if (::fstat(stored_fd_, &info) == 0) {
+        file_size = static_cast<uint64_t>(info.st_size);
+    }
+#else
+    stored_.seekg(0, std::ios::end);
+    file_size = static_cast<uint64_t>(std::max<std::streamoff>(stored_.tellg(), 0));
+#endif
+
+    // Заголовок: магия, версия, размер хеша, размер блока, алгоритм,
+    // смещение индекса и число записей
+    struct Header {
+        char magic[sizeof(cache_magic)];
+        uint32_t version;
+        uint32_t digest_size;
+        uint64_t block_size;
+        char algorithm[algorithm_field_size];
+        uint64_t index_offset;
+        uint64_t entry_count;
+    } header;
+    static_assert(sizeof(Header) == sizeof(cache_magic) + 2 * sizeof(uint32_t) + sizeof(uint64_t) +
+                                        algorithm_field_size + 2 * sizeof(uint64_t),
+                  "cache header must have no padding");
+
+    bool ok = read_stored(0, &header, sizeof(header)) &&
+              std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) == 0 &&
+              header.version == cache_version && header.digest_size == digest_size_ &&
+              header.block_size == block_size_ &&
+              std::string(header.algorithm, strnlen(header.algorithm, algorithm_field_size)) == algorithm_;
+
+    // Индекс целиком помещается между заголовком и концом файла
+    ok = ok && header.index_offset >= sizeof(Header) && header.index_offset <= file_size &&
+         header.entry_count <= (file_size - header.index_offset) / sizeof(IndexRecord);
+
+    if (ok) {
+        // Индекс лежит в конце файла и читается целиком, хеши - только по запросу
+        std::vector<IndexRecord> index(static_cast<size_t>(header.entry_count));
+        ok = read_stored(header.index_offset, index.data(), index.size() * sizeof(IndexRecord));
+        entries_.reserve(index.size());
+        for (size_t i = 0; ok && i < index.size(); ++i) {
+            const IndexRecord& record = index[i];
+            // Хешей не больше, чем блоков в файле, и все они лежат до индекса
+            uint64_t blocks = record.size / block_size_ + (record.size % block_size_ != 0);
+            ok = record.prefix <= blocks && record.scattered <= blocks - record.prefix &&
+                 record.offset >= sizeof(Header) && record.offset <= header.index_offset;
+            if (ok) {
+                uint64_t room = header.index_offset - record.offset;
+                ok = record.prefix <= room / digest_size_ &&
+                     record.scattered <= (room - record.prefix * digest_size_) /
+                                             (sizeof(uint64_t) + digest_size_);
+            }
+            if (ok) {
+                entries_[Key{record.device, record.inode}] =
+                    Entry{record.size, record.mtime, record.offset, record.prefix,
+                          record.scattered, false, false, KnownHashes()};
+            }
+        }
+    }
+
+    if (!ok) {
+        // Кэш от другой версии или с другими параметрами - начинаем заново
+        entries_.clear();
+        close_stored();
+    }
+}
+
+bool BlockCache::read_stored_digests(const Entry& entry, KnownHashes& hashes) {
+    if (!stored_open()) {
+        return false;
+    }
+    hashes = KnownHashes(digest_size_);
+    std::vector<uint8_t>& prefix = hashes.prefix();
+    std::vector<uint64_t>& blocks = hashes.blocks();
+    std::vector<uint8_t>& scattered = hashes.scattered();
+    prefix.resize(entry.prefix * digest_size_);
+    blocks.resize(entry.scattered);
+    scattered.resize(entry.scattered * digest_size_);
+    uint64_t offset = entry.offset;
+    if (!read_stored(offset, prefix.data(), prefix.size())) {
+        return false;
+    }
+    offset += prefix.size();
+    if (!read_stored(offset, blocks.data(), blocks.size() * sizeof(uint64_t))) {
+        return false;
+    }
+    offset += blocks.size() * sizeof(uint64_t);
+    if (!read_stored(offset, scattered.data(), scattered.size())) {
+        return false;
+    }
+    // Отдельные блоки - строго по возрастанию, за префиксом и внутри файла
+    uint64_t total_blocks = entry.size / block_size_ + (entry.size % block_size_ != 0);
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        if (blocks[i] <= entry.prefix || blocks[i] >= total_blocks ||
+            (i > 0 && blocks[i] <= blocks[i - 1])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+KnownHashes BlockCache::lookup(const FileRecord& record) {
+    KnownHashes hashes(digest_size_);
+    if (record.device == 0 && record.inode == 0) {
+        return hashes;  // Идентичность файла неизвестна - кэшировать нельзя
+    }
+
+    Key key{record.device, record.inode};
+    Entry stored = Entry();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it == entries_.end()) {
+            return hashes;
+        }
+        Entry& entry = it->second;
+        if (entry.size != record.size || entry.mtime != record.mtime) {
+            // Файл изменился - запись больше не действительна
+            entries_.erase(it);
+            return hashes;
+        }
+        entry.used = true;
+        if (entry.fresh) {
+            return entry.hashes;
+        }
+        stored = entry;  // Хеши ещё в файле - копия без них, читаем вне блокировки
+    }
+
+    if (!read_stored_digests(stored, hashes)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end() && !it->second.fresh && it->second.offset == stored.offset) {
+            entries_.erase(it);
+        }
+        hashes = KnownHashes(digest_size_);
+    }
+    return hashes;
+}
+
+void BlockCache::store(const FileRecord& record, const KnownHashes& hashes) {
+    if ((record.device == 0 && record.inode == 0) || hashes.empty()) {
+        return;
+    }
+
+    Key key{record.device, record.inode};
+    KnownHashes merged = hashes;
+    Entry stored = Entry();
+    bool have_stored = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end() && it->second.size == record.size &&
+            it->second.mtime == record.mtime && !it->second.fresh) {
+            stored = it->second;
+            have_stored = true;
+        }
+    }
+    // Хеши того же содержимого из файла кэша - тоже вне блокировки
+    KnownHashes previous;
+    if (have_stored && read_stored_digests(stored, previous)) {
+        merged.merge(previous);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end() && it->second.size == record.size &&
+        it->second.mtime == record.mtime) {
+        // Объединяем с уже известными хешами этого же содержимого
+        Entry& entry = it->second;
+        entry.used = true;
+        if (entry.fresh) {
+            merged.merge(entry.hashes);
+        }
+        if (merged.count() == entry.prefix + entry.scattered) {
+            return;  // Ничего нового
+        }
+    }
+    uint64_t prefix = merged.prefix_count();
+    uint64_t scattered = merged.scattered_count();
+    entries_[key] = Entry{record.size, record.mtime, 0, prefix, scattered, true, true,
+                          std::move(merged)};
+}
+
+void BlockCache::save() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Упорядочиваем записи, чтобы файл кэша не зависел от порядка хеш-таблицы.
+    // Записи, не понадобившиеся в этом запуске (файл удалён или не сканировался),
+    // не сохраняются - иначе общий для разных деревьев кэш растёт без предела.
+    std::vector<std::pair<Key, Entry*>> ordered;
+    ordered.reserve(entries_.size());
+    for (auto& pair : entries_) {
+        if (pair.second.used) {
+            ordered.emplace_back(pair.first, &pair.second);
+        }
+    }
+    std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) {
+        return a.first.device != b.first.device ? a.first.device < b.first.device
+                                                : a.first.inode < b.first.inode;
+    });
+
+    boost::filesystem::path temp_path = cache_path_;
+    temp_path += ".tmp";
+    std::ofstream out(temp_path.string(), std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Warning: Cannot write cache " << temp_path << std::endl;
+        return;
+    }
+
+    char algorithm[algorithm_field_size] = {};
+    std::memcpy(algorithm, algorithm_.data(), std::min(algorithm_.size(), algorithm_field_size));
+
+    // Заголовок; смещение индекса и число записей дописываются в конце
+    out.write(cache_magic, sizeof(cache_magic));
+    write_value(out, cache_version);
+    write_value(out, static_cast<uint32_t>(digest_size_));
+    write_value(out, static_cast<uint64_t>(block_size_));
+    out.write(algorithm, sizeof(algorithm));
+    std::streamoff index_field = out.tellp();
+    write_value(out, static_cast<uint64_t>(0));
+    write_value(out, static_cast<uint64_t>(0));
+
+    // Хеши; записи, которые не удалось прочитать из старого файла, выбрасываются
+    std::vector<IndexRecord> index;
+    index.reserve(ordered.size());
+    KnownHashes stored;
+    for (const auto& item : ordered) {
+        const Entry& entry = *item.second;
+        const KnownHashes* source = &entry.hashes;
+        if (!entry.fresh) {
+            if (!read_stored_digests(entry, stored)) {
+                continue;
+            }
+            source = &stored;
+        }
+        uint64_t offset = static_cast<uint64_t>(out.tellp());
+        out.write(reinterpret_cast<const char*>(source->prefix().data()),
+                  static_cast<std::streamsize>(source->prefix().size()));
+        out.write(reinterpret_cast<const char*>(source->blocks().data()),
+                  static_cast<std::streamsize>(source->blocks().size() * sizeof(uint64_t)));
+        out.write(reinterpret_cast<const char*>(source->scattered().data()),
+                  static_cast<std::streamsize>(source->scattered().size()));
+        index.push_back(IndexRecord{item.first.device, item.first.inode, entry.size, entry.mtime,
+                                    offset, source->prefix_count(), source->scattered_count()});
+    }
+
+    uint64_t index_offset = static_cast<uint64_t>(out.tellp());
+    for (const auto& record : index) {
+        write_value(out, record);
+    }
+    out.seekp(index_field);
+    write_value(out, index_offset);
+    write_value(out, static_cast<uint64_t>(index.size()));
+
+    out.close();
+    close_stored();
+    if (!out) {
+        std::cerr << "Warning: Cannot write cache " << temp_path << std::endl;
+        return;
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::rename(temp_path, cache_path_, ec);
+    if (ec) {
+        std::cerr << "Warning: Cannot replace cache " << cache_path_ << ": " << ec.message() << std::endl;
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "FileRecord.h"
+#include "FileReader.h"
+#include "KnownHashes.h"
+
+// Постоянный кэш хешей блоков между запусками.
+// Запись привязана к (устройство, inode) и действительна, пока совпадают
+// размер и время изменения файла. Хранятся хеши всех блоков, которые
+// понадобились при разбиении: префикс 0..n-1 и отдельные блоки выборки.
+// Сохраняются только записи файлов, встреченных в текущем запуске, - записи
+// удалённых файлов и файлов вне просканированных директорий выбрасываются.
+//
+// Формат файла: заголовок, хеши подряд, в конце индекс фиксированного размера.
+// При загрузке читаются только заголовок и индекс, хеши - по запросу.
+// Мьютекс защищает только таблицу записей: хеши из файла читаются без него,
+// поэтому попадания в кэш из разных потоков не выстраиваются в очередь.
+class BlockCache {
+private:
+    struct Key {
+        uint64_t device;
+        uint64_t inode;
+
+        bool operator==(const Key& other) const {
+            return device == other.device && inode == other.inode;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<uint64_t>()(key.device * 0x9e3779b97f4a7c15ULL ^ key.inode);
+        }
+    };
+
+    struct Entry {
+        uint64_t size;
+        int64_t mtime;
+        uint64_t offset;                    // Смещение хешей в загруженном файле кэша
+        uint64_t prefix;                    // Число хешей префикса
+        uint64_t scattered;                 // Число отдельных блоков
+        bool fresh;                         // Хеши в hashes, а не в файле
+        bool used;                          // Запрошена или обновлена в этом запуске
+        KnownHashes hashes;
+    };
+
+    boost::filesystem::path cache_path_;
+    size_t block_size_;
+    std::string algorithm_;
+    size_t digest_size_;
+
+    std::mutex mutex_;                      // Защищает entries_
+    std::unordered_map<Key, Entry, KeyHash> entries_;
+
+    // Загруженный файл кэша (для чтения хешей)
+#ifdef BAYAN_POSIX_IO
+    int stored_fd_;                         // Читается pread, общей позиции чтения нет
+#else
+    std::mutex stored_mutex_;               // Защищает позицию чтения stored_
+    std::ifstream stored_;
+#endif
+
+    bool stored_open() const;
+    void close_stored();
+    bool read_stored(uint64_t offset, void* buffer, size_t length);
+    // Вызывается без mutex_: entry - копия записи, взятая под ним
+    bool read_stored_digests(const Entry& entry, KnownHashes& hashes);
+
+public:
+    BlockCache(const boost::filesystem::path& cache_path, size_t block_size,
+               const std::string& algorithm, size_t digest_size);
+    ~BlockCache();
+
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+
+    // Загрузить индекс. Отсутствующий, повреждённый (в том числе со смещениями
+    // и счётчиками за пределами файла) или созданный с другими параметрами
+    // (размер блока, алгоритм) кэш молча игнорируется.
+    void load();
+
+    // Известные хеши блоков файла; пусто, если файл изменился или не кэширован
+    KnownHashes lookup(const FileRecord& record);
+
+    // Запомнить хеши блоков файла (вместе с уже известными)
+    void store(const FileRecord& record, const KnownHashes& hashes);
+
+    // Записать кэш на диск (через временный файл); только записи,
+    // запрошенные или обновлённые в этом запуске
+    void save();
+};
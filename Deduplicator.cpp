@@ -0,0 +1,210 @@
+#include "Deduplicator.h"
+#include "FileRecord.h"
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+#endif
+
+namespace {
+    // Файл не изменился с момента сканирования
+    bool unchanged(const DuplicateFile& file, uintmax_t size) {
+        FileRecord current;
+        return current.stat(file.path) && current.size == size && current.mtime == file.mtime &&
+               current.device == file.device && current.inode == file.inode;
+    }
+
+    // Временное имя рядом с target: переименование в пределах директории атомарно
+    boost::filesystem::path temporary_name(const boost::filesystem::path& target) {
+        return target.parent_path() /
+               boost::filesystem::unique_path(target.filename().string() + ".bayan-%%%%%%%%");
+    }
+
+    void warn(const DuplicateFile& file, const std::string& reason) {
+        // Одна запись целиком, чтобы сообщения потоков не перемешивались
+        std::ostringstream message;
+        message << "Warning: Skipping " << file.path << ": " << reason << "\n";
+        std::cerr << message.str() << std::flush;
+    }
+
+    // Клон source под именем temp с правами и временами target
+    bool clone_file(const boost::filesystem::path& source, const boost::filesystem::path& temp,
+                    const boost::filesystem::path& target, std::string& error) {
+#if defined(__linux__)
+        struct stat target_stat;
+        if (::stat(target.c_str(), &target_stat) != 0) {
+            error = std::strerror(errno);
+            return false;
+        }
+        int source_fd = ::open(source.c_str(), O_RDONLY);
+        if (source_fd < 0) {
+            error = std::strerror(errno);
+            return false;
+        }
+        int temp_fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL, target_stat.st_mode & 07777);
+        if (temp_fd < 0) {
+            error = std::strerror(errno);
+            ::close(source_fd);
+            return false;
+        }
+        bool cloned = ::ioctl(temp_fd, FICLONE, source_fd) == 0;
+        if (!cloned) {
+            error = errno == EOPNOTSUPP || errno == EINVAL || errno == EXDEV
+                        ? "filesystem does not support reflinks"
+                        : std::strerror(errno);
+        } else {
+            // Права без учёта umask, владелец - по возможности, времена копии
+            ::fchmod(temp_fd, target_stat.st_mode & 07777);
+            if (::fchown(temp_fd, target_stat.st_uid, target_stat.st_gid) != 0) {
+                // Без прав на смену владельца клон остаётся за текущим пользователем
+            }
+            struct timespec times[2] = {target_stat.st_atim, target_stat.st_mtim};
+            ::futimens(temp_fd, times);
+        }
+        ::close(temp_fd);
+        ::close(source_fd);
+        if (!cloned) {
+            ::unlink(temp.c_str());
+        }
+        return cloned;
+#else
+        (void)source;
+        (void)temp;
+        (void)target;
+        error = "reflinks are not supported on this platform";
+        return false;
+#endif
+    }
+}
+
+Deduplicator::Deduplicator(DedupAction action, bool dry_run, size_t threads, size_t batch_size)
+    : action_(action), dry_run_(dry_run), batch_size_(std::max<size_t>(batch_size, 1)),
+      pool_(ThreadPool::resolve_thread_count(threads)), batch_(), replaced_(0), skipped_(0),
+      saved_(0) {}
+
+DedupAction Deduplicator::parse_action(const std::string& name) {
+    if (name == "hardlink") {
+        return DedupAction::hardlink;
+    }
+    if (name == "reflink") {
+        return DedupAction::reflink;
+    }
+    if (name == "delete") {
+        return DedupAction::remove;
+    }
+    throw std::invalid_argument("Unknown action: " + name);
+}
+
+void Deduplicator::submit(DuplicateGroup&& group) {
+    batch_.push_back(std::move(group));
+    if (batch_.size() >= batch_size_) {
+        std::vector<DuplicateGroup> batch;
+        batch.swap(batch_);
+        pool_.submit([this, batch = std::move(batch)]() {
+            for (const DuplicateGroup& group : batch) {
+                process(group);
+            }
+        });
+    }
+}
+
+void Deduplicator::finish() {
+    if (!batch_.empty()) {
+        std::vector<DuplicateGroup> batch;
+        batch.swap(batch_);
+        pool_.submit([this, batch = std::move(batch)]() {
+            for (const DuplicateGroup& group : batch) {
+                process(group);
+            }
+        });
+    }
+    pool_.wait();
+}
+
+void Deduplicator::process(const DuplicateGroup& group) {
+    if (group.files.size() < 2) {
+        return;
+    }
+    const DuplicateFile& keeper = group.files.front();
+    if (!unchanged(keeper, group.size)) {
+        warn(keeper, "changed since it was compared");
+        skipped_ += group.files.size() - 1;
+        return;
+    }
+
+    // Освобождается место одного inode, сколько бы путей на него ни вело
+    std::set<std::pair<uint64_t, uint64_t>> freed;
+    for (size_t i = 1; i < group.files.size(); ++i) {
+        const DuplicateFile& target = group.files[i];
+        if (target.inode != 0 && target.device == keeper.device && target.inode == keeper.inode) {
+            continue;  // Уже тот же файл
+        }
+        if (!unchanged(target, group.size)) {
+            warn(target, "changed since it was compared");
+            ++skipped_;
+            continue;
+        }
+        if (action_ == DedupAction::hardlink && target.device != keeper.device) {
+            warn(target, "on a different device than " + keeper.path.string());
+            ++skipped_;
+            continue;
+        }
+
+        std::string error;
+        if (!dry_run_ && !apply(keeper, target, error)) {
+            warn(target, error);
+            ++skipped_;
+            continue;
+        }
+        ++replaced_;
+        if (target.inode == 0 || freed.emplace(target.device, target.inode).second) {
+            saved_ += group.size;
+        }
+    }
+}
+
+bool Deduplicator::apply(const DuplicateFile& keeper, const DuplicateFile& target,
+                         std::string& error) {
+    boost::system::error_code ec;
+    if (action_ == DedupAction::remove) {
+        boost::filesystem::remove(target.path, ec);
+        if (ec) {
+            error = ec.message();
+            return false;
+        }
+        return true;
+    }
+
+    boost::filesystem::path temp = temporary_name(target.path);
+    if (action_ == DedupAction::hardlink) {
+        boost::filesystem::create_hard_link(keeper.path, temp, ec);
+        if (ec) {
+            error = ec.message();
+            return false;
+        }
+    } else if (!clone_file(keeper.path, temp, target.path, error)) {
+        return false;
+    }
+
+    boost::filesystem::rename(temp, target.path, ec);
+    if (ec) {
+        error = ec.message();
+        boost::system::error_code ignored;
+        boost::filesystem::remove(temp, ignored);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "DuplicateGroup.h"
+#include "ThreadPool.h"
+
+// Действие над подтверждёнными дубликатами (--action)
+enum class DedupAction {
+    hardlink,   // Заменить копию жёсткой ссылкой на оставляемый файл
+    reflink,    // Заменить копию клоном (FICLONE): общие блоки, отдельный inode
+    remove      // Удалить копию
+};
+
+// Освобождение места: в каждой группе остаётся первый файл, остальные
+// заменяются или удаляются. Группы принимаются по мере нахождения и
+// обрабатываются пачками в собственном пуле потоков.
+//
+// Перед заменой размер, время изменения и inode обоих файлов сверяются
+// с данными сканирования: файл, изменившийся после сравнения, пропускается.
+// Замена атомарна: ссылка или клон создаётся под временным именем в той же
+// директории и переименовывается поверх копии. Пути к тому же inode, что
+// и оставляемый файл, не трогаются - места они не занимают.
+class Deduplicator {
+private:
+    DedupAction action_;
+    bool dry_run_;
+    size_t batch_size_;
+    ThreadPool pool_;
+    std::vector<DuplicateGroup> batch_;     // Группы, ещё не отданные в пул
+
+    std::atomic<size_t> replaced_;
+    std::atomic<size_t> skipped_;
+    std::atomic<uintmax_t> saved_;
+
+    void process(const DuplicateGroup& group);
+
+    // Заменить target согласно действию; false и описание ошибки в error
+    bool apply(const DuplicateFile& keeper, const DuplicateFile& target, std::string& error);
+
+public:
+    Deduplicator(DedupAction action, bool dry_run, size_t threads, size_t batch_size = 64);
+
+    // Разобрать значение --action; неизвестное значение - std::invalid_argument
+    static DedupAction parse_action(const std::string& name);
+
+    // Принять группу (вызывается последовательно, из любого потока)
+    void submit(DuplicateGroup&& group);
+
+    // Обработать оставшиеся группы и дождаться завершения
+    void finish();
+
+    size_t replaced() const { return replaced_; }
+    size_t skipped() const { return skipped_; }
+    uintmax_t saved_bytes() const { return saved_; }
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Файл подтверждённой группы дубликатов
+struct DuplicateFile {
+    boost::filesystem::path path;
+    uint64_t device;                // Устройство и inode (0, если неизвестны)
+    uint64_t inode;
+    int64_t mtime;                  // Время изменения при сканировании, нс от эпохи
+};
+
+// Группа файлов с одинаковым содержимым
+struct DuplicateGroup {
+    uintmax_t size;                 // Размер каждого файла
+    std::vector<DuplicateFile> files;
+
+    // Байты, освобождаемые, если оставить одну копию: размер, умноженный на
+    // число различных inode без одного (жёсткие ссылки места не занимают)
+    uintmax_t reclaimable_bytes() const {
+        std::vector<std::pair<uint64_t, uint64_t>> identities;
+        size_t unknown = 0;
+        for (const DuplicateFile& file : files) {
+            if (file.inode == 0) {
+                ++unknown;
+            } else {
+                identities.emplace_back(file.device, file.inode);
+            }
+        }
+        std::sort(identities.begin(), identities.end());
+        size_t distinct = static_cast<size_t>(
+            std::unique(identities.begin(), identities.end()) - identities.begin()) + unknown;
+        return distinct > 1 ? size * (distinct - 1) : 0;
+    }
+};
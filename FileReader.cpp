@@ -0,0 +1,390 @@
+#include "FileReader.h"
+#include "Stats.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef BAYAN_POSIX_IO
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // Выравнивание окна и смещений чтения - размер страницы
+    const size_t page_size = 4096;
+
+    uintmax_t align_down(uintmax_t value) {
+        return value - value % page_size;
+    }
+
+    size_t align_up(size_t value) {
+        return (value + page_size - 1) / page_size * page_size;
+    }
+}
+
+ReadOptions::ReadOptions()
+#ifdef BAYAN_POSIX_IO
+    : mode(IoMode::pread),
+#else
+    : mode(IoMode::stream),
+#endif
+      read_size(128 * 1024),
+      async(AsyncEngine::none),
+      queue_depth(64),
+      max_open_files(default_max_open_files()),
+      memory_limit(0),
+      stats(nullptr) {}
+
+size_t ReadOptions::default_max_open_files() {
+#ifdef BAYAN_POSIX_IO
+    struct rlimit limit;
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+        return std::max<size_t>(static_cast<size_t>(limit.rlim_cur) / 2, 16);
+    }
+#endif
+    return 256;
+}
+
+IoMode ReadOptions::parse_mode(const std::string& name) {
+    if (name == "stream") {
+        return IoMode::stream;
+    }
+    if (name == "pread") {
+        return IoMode::pread;
+    }
+    if (name == "mmap") {
+        return IoMode::mmap;
+    }
+    throw std::invalid_argument("Unknown I/O mode: " + name);
+}
+
+size_t ReadOptions::parse_size(const std::string& text) {
+    size_t digits = 0;
+    while (digits < text.size() && text[digits] >= '0' && text[digits] <= '9') {
+        ++digits;
+    }
+    std::string suffix = text.substr(digits);
+    size_t shift = 0;
+    if (suffix == "K" || suffix == "k") {
+        shift = 10;
+    } else if (suffix == "M" || suffix == "m") {
+        shift = 20;
+    } else if (suffix == "G" || suffix == "g") {
+        shift = 30;
+    } else if (!suffix.empty()) {
+        throw std::invalid_argument("Invalid size: " + text);
+    }
+    if (digits == 0 || digits > 15) {
+        throw std::invalid_argument("Invalid size: " + text);
+    }
+    unsigned long long value = std::stoull(text.substr(0, digits));
+    if (value > (static_cast<unsigned long long>(SIZE_MAX) >> shift)) {
+        throw std::invalid_argument("Size too large: " + text);
+    }
+    return static_cast<size_t>(value) << shift;
+}
+
+FileReader::FileReader(const boost::filesystem::path& path, uintmax_t size,
+                       const ReadOptions& options)
+    : path_(path), size_(size), mode_(options.mode),
+      read_size_(std::max<size_t>(options.read_size, page_size)), stats_(options.stats),
+      window_(nullptr), window_capacity_(0), window_offset_(0), window_length_(0),
+#ifdef BAYAN_POSIX_IO
+      fd_(-1), map_(nullptr),
+#endif
+      stream_(), opened_(false), failed_(false) {
+#ifndef BAYAN_POSIX_IO
+    // Без POSIX доступен только потоковый режим
+    mode_ = IoMode::stream;
+#endif
+}
+
+FileReader::~FileReader() {
+    close();
+    std::free(window_);
+}
+
+bool FileReader::open() {
+    if (opened_ || failed_) {
+        return opened_;
+    }
+    failed_ = true;
+
+    if (mode_ == IoMode::stream) {
+        if (!ensure_descriptor()) {
+            return false;
+        }
+        opened_ = true;
+        failed_ = false;
+        return true;
+    }
+
+#ifdef BAYAN_POSIX_IO
+    if (!ensure_descriptor()) {
+        return false;
+    }
+    // Размер проверяется по открытому дескриптору: отображение файла,
+    // укоротившегося после сканирования, привело бы к SIGBUS
+    struct stat st;
+    if (::fstat(fd_, &st) != 0 || static_cast<uintmax_t>(st.st_size) != size_) {
+        close();
+        return false;
+    }
+
+    if (mode_ == IoMode::mmap && size_ > 0) {
+        void* map = ::mmap(nullptr, static_cast<size_t>(size_), PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (map == MAP_FAILED) {
+            close();
+            return false;
+        }
+        ::madvise(map, static_cast<size_t>(size_), MADV_SEQUENTIAL);
+        map_ = static_cast<const char*>(map);
+        // Отображению дескриптор не нужен
+        release_descriptor();
+    }
+#if defined(POSIX_FADV_SEQUENTIAL)
+    else {
+        ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+#endif
+
+    opened_ = true;
+    failed_ = false;
+    return true;
+}
+
+bool FileReader::ensure_descriptor() {
+    if (mode_ == IoMode::stream) {
+        if (!stream_) {
+            stream_ = std::make_unique<std::ifstream>(path_.string(), std::ios::binary);
+            if (!stream_->is_open()) {
+                stream_.reset();
+                return false;
+            }
+        }
+        return true;
+    }
+#ifdef BAYAN_POSIX_IO
+    if (fd_ < 0) {
+        fd_ = ::open(path_.c_str(), O_RDONLY);
+    }
+    return fd_ >= 0;
+#else
+    return false;
+#endif
+}
+
+bool FileReader::is_open() const {
+    return opened_;
+}
+
+bool FileReader::reserve_window(size_t capacity) {
+    if (capacity <= window_capacity_) {
+        return true;
+    }
+    std::free(window_);
+    window_ = nullptr;
+    window_capacity_ = 0;
+#ifdef BAYAN_POSIX_IO
+    void* memory = nullptr;
+    if (::posix_memalign(&memory, page_size, capacity) != 0) {
+        return false;
+    }
+    window_ = static_cast<char*>(memory);
+#else
+    window_ = static_cast<char*>(std::malloc(capacity));
+    if (!window_) {
+        return false;
+    }
+#endif
+    window_capacity_ = capacity;
+    return true;
+}
+
+size_t FileReader::read_at(uintmax_t offset, char* buffer, size_t length) {
+    if (!ensure_descriptor()) {
+        return 0;
+    }
+    size_t total = 0;
+#ifdef BAYAN_POSIX_IO
+    // После снятия отображения (вытеснение) файл в режиме mmap читается через pread
+    if (mode_ != IoMode::stream) {
+        while (total < length) {
+            ssize_t got = ::pread(fd_, buffer + total, length - total,
+                                  static_cast<off_t>(offset + total));
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (stats_) {
+                stats_->add_call(Phase::hashing, got > 0 ? static_cast<uint64_t>(got) : 0);
+            }
+            if (got <= 0) {
+                break;
+            }
+            total += static_cast<size_t>(got);
+        }
+        return total;
+    }
+#endif
+    stream_->clear();
+    stream_->seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+    stream_->read(buffer, static_cast<std::streamsize>(length));
+    total = static_cast<size_t>(stream_->gcount());
+    if (stats_) {
+        stats_->add_call(Phase::hashing, total);
+    }
+    return total;
+}
+
+bool FileReader::in_window(uintmax_t offset, size_t length) const {
+    return offset >= window_offset_ && offset + length <= window_offset_ + window_length_;
+}
+
+size_t FileReader::plan_window(uintmax_t offset, size_t length, uintmax_t& start) {
+    // Новое окно: выровненное начало, не меньше read_size, не дальше конца файла
+    start = align_down(offset);
+    size_t head = static_cast<size_t>(offset - start);
+    size_t wanted = align_up(std::max(read_size_, head + length));
+    wanted = static_cast<size_t>(std::min<uintmax_t>(wanted, size_ - start));
+    if (!reserve_window(align_up(wanted))) {
+        return 0;
+    }
+    return wanted;
+}
+
+const char* FileReader::finish_window(uintmax_t start, size_t wanted, uintmax_t offset,
+                                      size_t length, size_t got) {
+    size_t head = static_cast<size_t>(offset - start);
+    window_offset_ = start;
+    window_length_ = got;
+    if (got < head + length) {
+        window_length_ = 0;
+        return nullptr;  // Файл укоротился после сканирования
+    }
+
+#if defined(BAYAN_POSIX_IO) && defined(POSIX_FADV_WILLNEED)
+    // Подсказка опережающего чтения для следующего окна
+    if (mode_ == IoMode::pread && fd_ >= 0 && start + got < size_) {
+        ::posix_fadvise(fd_, static_cast<off_t>(start + got), static_cast<off_t>(wanted),
+                        POSIX_FADV_WILLNEED);
+    }
+#else
+    (void)wanted;
+#endif
+
+    return window_ + head;
+}
+
+const char* FileReader::read(uintmax_t offset, size_t length) {
+    if (!open() || offset + length > size_) {
+        return nullptr;
+    }
+
+#ifdef BAYAN_POSIX_IO
+    if (map_) {
+        if (stats_) {
+            stats_->add_bytes(Phase::hashing, length);  // Страницы подгружаются без вызовов read
+        }
+        return map_ + offset;
+    }
+#endif
+
+    // Запрос целиком внутри окна - без обращения к диску
+    if (in_window(offset, length)) {
+        return window_ + (offset - window_offset_);
+    }
+
+    uintmax_t start = 0;
+    size_t wanted = plan_window(offset, length, start);
+    if (wanted == 0) {
+        return nullptr;
+    }
+    size_t got = read_at(start, window_, wanted);
+    return finish_window(start, wanted, offset, length, got);
+}
+
+bool FileReader::prepare_fetch(uintmax_t offset, size_t length, AsyncReader::Request& request) {
+#ifdef BAYAN_POSIX_IO
+    if (mode_ != IoMode::pread || !open() || offset + length > size_ ||
+        in_window(offset, length) || !ensure_descriptor()) {
+        return false;
+    }
+    uintmax_t start = 0;
+    size_t wanted = plan_window(offset, length, start);
+    if (wanted == 0) {
+        return false;
+    }
+    window_length_ = 0;  // Окно перезаписывается запросом
+    request.fd = fd_;
+    request.offset = start;
+    request.length = wanted;
+    request.buffer = window_;
+    return true;
+#else
+    (void)offset;
+    (void)length;
+    (void)request;
+    return false;
+#endif
+}
+
+const char* FileReader::complete_fetch(const AsyncReader::Request& request, uintmax_t offset,
+                                       size_t length, size_t bytes) {
+    if (stats_) {
+        stats_->add_call(Phase::hashing, bytes);
+    }
+    return finish_window(request.offset, request.length, offset, length, bytes);
+}
+
+void FileReader::release_descriptor() {
+#ifdef BAYAN_POSIX_IO
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+#endif
+    stream_.reset();
+}
+
+bool FileReader::holds_descriptor() const {
+#ifdef BAYAN_POSIX_IO
+    if (fd_ >= 0 || map_) {
+        return true;
+    }
+#endif
+    return stream_ != nullptr;
+}
+
+size_t FileReader::window_bytes() const {
+    return window_capacity_;
+}
+
+void FileReader::release_mapping() {
+#ifdef BAYAN_POSIX_IO
+    if (map_) {
+        ::munmap(const_cast<char*>(map_), static_cast<size_t>(size_));
+        map_ = nullptr;
+    }
+#endif
+}
+
+void FileReader::release_window() {
+    std::free(window_);
+    window_ = nullptr;
+    window_capacity_ = 0;
+    window_length_ = 0;
+}
+
+void FileReader::close() {
+    release_mapping();
+    release_descriptor();
+    window_length_ = 0;
+    opened_ = false;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include "AsyncReader.h"
+
+class Stats;
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BAYAN_POSIX_IO 1
+#endif
+
+// Способ чтения содержимого файлов
+enum class IoMode {
+    stream,     // std::ifstream - переносимый вариант
+    pread,      // Крупные выровненные pread с подсказками posix_fadvise (холодные данные)
+    mmap        // Отображение в память с MADV_SEQUENTIAL (данные в страничном кэше)
+};
+
+// Параметры чтения: логический блок хеширования (--block-size) не связан
+// с размером физического чтения - за один системный вызов читается окно
+// из нескольких блоков
+struct ReadOptions {
+    IoMode mode;
+    size_t read_size;           // Размер окна физического чтения в байтах
+    AsyncEngine async;          // Асинхронное чтение блоков корзины (только режим pread)
+    size_t queue_depth;         // Число одновременных асинхронных чтений на все потоки
+    size_t max_open_files;      // Предел открытых дескрипторов на все потоки
+    size_t memory_limit;        // Предел памяти окон чтения и хешей блоков на все потоки, 0 - без предела
+    Stats* stats;               // Счётчики чтений для --stats (может отсутствовать)
+
+    ReadOptions();
+
+    // Предел дескрипторов по умолчанию - половина RLIMIT_NOFILE
+    static size_t default_max_open_files();
+
+    // Разобрать значение --io; неизвестное значение - std::invalid_argument
+    static IoMode parse_mode(const std::string& name);
+
+    // Разобрать размер с необязательным суффиксом K, M или G (степени 1024);
+    // некорректное значение - std::invalid_argument
+    static size_t parse_size(const std::string& text);
+};
+
+// Чтение диапазонов файла через окно: запросы внутри уже прочитанного окна
+// не обращаются к диску. Указатель, возвращённый read(), действителен
+// до следующего вызова read() или close().
+class FileReader {
+private:
+    boost::filesystem::path path_;
+    uintmax_t size_;
+    IoMode mode_;
+    size_t read_size_;
+    Stats* stats_;
+
+    // Окно прочитанных данных
+    char* window_;
+    size_t window_capacity_;
+    uintmax_t window_offset_;
+    size_t window_length_;
+
+#ifdef BAYAN_POSIX_IO
+    int fd_;
+    const char* map_;           // Отображение файла (режим mmap)
+#endif
+    std::unique_ptr<std::ifstream> stream_;
+    bool opened_;               // Файл открывался и прошёл проверку размера
+    bool failed_;
+
+    bool reserve_window(size_t capacity);
+    bool ensure_descriptor();
+    bool in_window(uintmax_t offset, size_t length) const;
+    size_t plan_window(uintmax_t offset, size_t length, uintmax_t& start);
+    const char* finish_window(uintmax_t start, size_t wanted, uintmax_t offset,
+                              size_t length, size_t got);
+    size_t read_at(uintmax_t offset, char* buffer, size_t length);
+
+public:
+    FileReader(const boost::filesystem::path& path, uintmax_t size, const ReadOptions& options);
+    ~FileReader();
+
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+
+    // Открыть файл; false, если файл недоступен или его размер изменился
+    bool open();
+    bool is_open() const;
+
+    // Данные [offset, offset + length) или nullptr, если их не удалось прочитать
+    const char* read(uintmax_t offset, size_t length);
+
+    // Асинхронное чтение в режиме pread: если данных нет в окне, подготовить
+    // запрос на новое окно и вернуть true. После выполнения запроса данные
+    // забираются через complete_fetch().
+    bool prepare_fetch(uintmax_t offset, size_t length, AsyncReader::Request& request);
+    const char* complete_fetch(const AsyncReader::Request& request, uintmax_t offset,
+                               size_t length, size_t bytes);
+
+    // Закрыть дескриптор, сохранив окно: следующее чтение вне окна
+    // откроет файл заново
+    void release_descriptor();
+
+    // Ресурсы, которые можно освободить без потери состояния файла
+    // (для вытеснения давно не читавшихся файлов): дескриптор или
+    // отображение и память окна
+    bool holds_descriptor() const;
+    size_t window_bytes() const;
+
+    // Снять отображение: следующие чтения пойдут через окно и pread
+    void release_mapping();
+
+    // Освободить окно: следующее чтение прочитает данные заново
+    void release_window();
+
+    void close();
+};
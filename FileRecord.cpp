@@ -0,0 +1,39 @@
+#include "FileRecord.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#endif
+
+FileRecord::FileRecord() : id(0), size(0), device(0), inode(0), mtime(0) {}
+
+FileRecord::FileRecord(uint32_t id) : id(id), size(0), device(0), inode(0), mtime(0) {}
+
+bool FileRecord::stat(const boost::filesystem::path& path) {
+#if defined(__unix__) || defined(__APPLE__)
+    struct ::stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    size = static_cast<uintmax_t>(st.st_size);
+    device = static_cast<uint64_t>(st.st_dev);
+    inode = static_cast<uint64_t>(st.st_ino);
+#if defined(__APPLE__)
+    mtime = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    return true;
+#else
+    // Без POSIX stat идентичность файла неизвестна, берём только размер и время
+    boost::system::error_code ec;
+    size = boost::filesystem::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    std::time_t write_time = boost::filesystem::last_write_time(path, ec);
+    mtime = ec ? 0 : static_cast<int64_t>(write_time) * 1000000000;
+    device = 0;
+    inode = 0;
+    return true;
+#endif
+}
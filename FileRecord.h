@@ -0,0 +1,30 @@
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <cstdint>
+
+// Сведения о файле, собранные одним вызовом stat во время сканирования.
+// Дальше по конвейеру размер и идентичность файла повторно не запрашиваются.
+// Путь хранится в PathStore сканера, запись несёт только его номер.
+struct FileRecord {
+    uint32_t id;                    // Номер пути в PathStore
+    uintmax_t size;                 // Размер в байтах
+    uint64_t device;                // Устройство (0 - неизвестно)
+    uint64_t inode;                 // Номер inode (0 - неизвестен)
+    int64_t mtime;                  // Время изменения, нс от эпохи
+
+    FileRecord();
+    explicit FileRecord(uint32_t id);
+
+    // Заполнить size/device/inode/mtime одним запросом к файловой системе.
+    // Возвращает false, если файл недоступен.
+    bool stat(const boost::filesystem::path& path);
+
+    // Идентичность (device, inode) известна - можно распознать жёсткие ссылки
+    bool has_identity() const { return inode != 0; }
+
+    // Тот же файл на диске: жёсткая ссылка или повторный путь через bind mount
+    bool same_file(const FileRecord& other) const {
+        return has_identity() && device == other.device && inode == other.inode;
+    }
+};
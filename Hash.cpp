@@ -1,130 +1,337 @@
 #include "Hash.h"
-#include <boost/crc.hpp>
-#include <sstream>
-#include <iomanip>
 #include <iostream>
 #include <memory>
 #include <algorithm>
 #include <unordered_set>
+#include <cstring>
+#include "ThreadPool.h"
+#include "BlockCache.h"
+
+Hash::Hash(size_t block_size, const Hasher& hasher, size_t threads, BlockCache* cache,
+           const ReadOptions& read_options, size_t samples, bool report_hardlinks,
+           Stats* stats, bool verify)
+    : block_size(block_size), hasher(hasher), block_kernel(hasher.block_kernel(block_size)),
+      digest_size(hasher.digest_size()),
+      threads(ThreadPool::resolve_thread_count(threads)), read_options(read_options),
+      cache(cache), samples(samples), report_hardlinks(report_hardlinks), stats(stats),
+      verify(verify) {
+    // Окно чтения вмещает хотя бы один блок целиком
+    this->read_options.read_size = std::max(this->read_options.read_size, block_size);
+}
 
-Hash::Hash(size_t block_size) : block_size(block_size) {}
-
-// Конструктор - НЕ читает с диска!
-Hash::FileHandle::FileHandle(const boost::filesystem::path& file_path)
-    : path(file_path), size(0), stream(nullptr), block_cache() {
+// Конструктор - НЕ читает с диска! Размер уже известен из сканирования
+Hash::FileHandle::FileHandle(const FileRecord& record, const ReadOptions& options,
+                             const PathStore& paths)
+    : record(record), read_options(&options), paths(&paths), reader(nullptr), known_hashes(),
+      cache_loaded(false), resident(nullptr), resident_position(), charged_descriptor(false),
+      charged_bytes(0) {
     // Пусто - ничего не читаем и не открываем!
 }
 
-// Ленивое получение размера файла
 uintmax_t Hash::FileHandle::get_size() const {
-    if (size == 0) {  // Еще не читали размер
-        try {
-            size = boost::filesystem::file_size(path);
-        } catch (const std::exception&) {
-            size = 0;
-        }
-    }
-    return size;
+    return record.size;
 }
 
-// Ленивое открытие файла
+// Ленивое открытие файла (при неудаче is_open() == false)
 void Hash::FileHandle::ensure_opened() const {
-    if (!stream) {  // Еще не открывали файл
-        stream = std::make_unique<std::ifstream>(path.string(), std::ios::binary);
-        if (!stream->is_open()) {
-            stream.reset();
-        }
+    if (!reader) {  // Еще не открывали файл
+        reader = std::make_unique<FileReader>(paths->path(record.id), record.size, *read_options);
+        reader->open();
     }
 }
 
-// Ленивое получение потока
-std::ifstream& Hash::FileHandle::get_stream() const {
+// Ленивое получение читателя
+FileReader& Hash::FileHandle::get_reader() const {
     ensure_opened();  // Открываем файл при первом обращении
-    return *stream;
+    return *reader;
 }
 
-// Закрытие потока
-void Hash::FileHandle::close_stream() {
-    if (stream) {
-        stream->close();
+// Закрытие файла с сохранением состояния handle
+void Hash::FileHandle::close_reader() {
+    if (reader) {
+        reader->close();
     }
 }
 
 bool Hash::FileHandle::is_valid() const {
-    return get_size() > 0;  // Вызовет ленивое чтение размера
+    return record.size > 0;
 }
 
 void Hash::FileHandle::close() { 
-    stream.reset(); 
-    size = 0;
-    block_cache.clear();
+    ResidentSet::forget(*this);
+    reader.reset(); 
+    record.size = 0;
+    known_hashes.clear();
+}
+
+void Hash::release(FileHandle& handle) {
+    if (cache && handle.is_valid() && !handle.known_hashes.empty()) {
+        cache->store(handle.record, handle.known_hashes);
+    }
+    handle.close();
+}
+
+Hash::ResidentSet::~ResidentSet() {
+    for (FileHandle* handle : order) {
+        handle->resident = nullptr;
+        handle->charged_descriptor = false;
+        handle->charged_bytes = 0;
+    }
 }
 
-std::string Hash::hash_crc32(const std::string &data) {
-    boost::crc_32_type crc_calculator;
-    crc_calculator.process_bytes(data.data(), data.size());
-    uint32_t checksum = crc_calculator.checksum();
+void Hash::ResidentSet::touch(FileHandle& handle) {
+    if (handle.resident == this) {
+        order.splice(order.begin(), order, handle.resident_position);
+    } else {
+        forget(handle);
+        order.push_front(&handle);
+        handle.resident = this;
+        handle.resident_position = order.begin();
+    }
+    recharge(handle);
+}
+
+void Hash::ResidentSet::recharge(FileHandle& handle) {
+    // Между чтениями файл мог открыться, получить окно или хеши из кэша
+    bool descriptor = handle.reader && handle.reader->holds_descriptor();
+    size_t held = handle.known_hashes.memory() +
+                  (handle.reader ? handle.reader->window_bytes() : 0);
+    descriptors = descriptors - (handle.charged_descriptor ? 1 : 0) + (descriptor ? 1 : 0);
+    bytes = bytes - handle.charged_bytes + held;
+    handle.charged_descriptor = descriptor;
+    handle.charged_bytes = held;
+}
 
-    std::stringstream ss;
-    ss << std::hex << std::setw(8) << std::setfill('0') << checksum;
-    return ss.str();
+void Hash::ResidentSet::forget(FileHandle& handle) {
+    ResidentSet* set = handle.resident;
+    if (!set) {
+        return;
+    }
+    set->descriptors -= handle.charged_descriptor ? 1 : 0;
+    set->bytes -= handle.charged_bytes;
+    set->order.erase(handle.resident_position);
+    handle.resident = nullptr;
+    handle.charged_descriptor = false;
+    handle.charged_bytes = 0;
 }
 
-std::string Hash::get_block_hash(FileHandle& handle, size_t block_index) {
-    // Проверяем кэш
-    auto it = handle.block_cache.find(block_index);
-    if (it != handle.block_cache.end()) {
-        return it->second;
+size_t Hash::descriptor_share() const {
+    size_t share = read_options.max_open_files / threads;
+    // Кольцо io_uring потока тоже занимает дескриптор
+    if (read_options.async != AsyncEngine::none && share > 1) {
+        --share;
     }
+    return std::max<size_t>(share, 1);
+}
 
+size_t Hash::queue_share() const {
+    return std::max<size_t>(read_options.queue_depth / threads, 1);
+}
+
+size_t Hash::memory_share() const {
+    return read_options.memory_limit ? std::max<size_t>(read_options.memory_limit / threads, 1) : 0;
+}
+
+void Hash::enforce_budget(ResidentSet& resident, size_t reserve_files) {
+    size_t max_descriptors = descriptor_share();
+    size_t max_bytes = memory_share();
+    size_t reserve_bytes = reserve_files * read_options.read_size;
+    auto over_descriptors = [&]() {
+        return resident.descriptors + reserve_files > max_descriptors;
+    };
+    auto over_memory = [&]() {
+        return max_bytes != 0 && resident.bytes + reserve_bytes > max_bytes;
+    };
+
+    // От давних файлов к недавним; освобождается только то, чего не хватает
+    auto position = resident.order.end();
+    while (position != resident.order.begin() && (over_descriptors() || over_memory())) {
+        --position;
+        FileHandle& handle = **position;
+        bool drop_descriptor = over_descriptors();
+        bool drop_memory = over_memory();
+        if (handle.reader && drop_descriptor) {
+            handle.reader->release_descriptor();
+            handle.reader->release_mapping();
+        }
+        if (handle.reader && drop_memory) {
+            handle.reader->release_window();
+        }
+        if (drop_memory && !handle.known_hashes.empty()) {
+            // Хеши остаются в постоянном кэше и загрузятся снова при обращении;
+            // без кэша блоки будут прочитаны заново
+            if (cache) {
+                cache->store(handle.record, handle.known_hashes);
+                handle.cache_loaded = false;
+            }
+            handle.known_hashes.clear();
+        }
+        resident.recharge(handle);
+        if (!handle.charged_descriptor && handle.charged_bytes == 0) {
+            auto after = std::next(position);
+            ResidentSet::forget(handle);
+            position = after;
+        }
+    }
+}
+
+bool Hash::lookup_block_hash(FileHandle& handle, size_t block_index, uint8_t* digest) {
+    // Проверяем постоянный кэш: хеши блоков неизменившегося файла известны без чтения
+    if (cache && !handle.cache_loaded) {
+        handle.known_hashes = cache->lookup(handle.record);
+        handle.cache_loaded = true;
+    }
+    return handle.known_hashes.find(block_index, digest);
+}
+
+bool Hash::locate_block(FileHandle& handle, size_t block_index, uintmax_t& offset, size_t& length) {
     // Ленивая проверка валидности
     if (!handle.is_valid()) {
-        return "";
+        return false;
     }
 
-    uintmax_t file_size = handle.get_size();  // Уже кэширован после is_valid()
-    
-    // Позиционируемся на нужный блок
-    std::ifstream& file = handle.get_stream();  // Откроет файл только сейчас!
-    if (!file.is_open()) {
-        return "";
+    uintmax_t file_size = handle.get_size();
+    offset = static_cast<uintmax_t>(block_index) * block_size;
+    if (offset >= file_size) {
+        return false;
     }
-    
-    file.clear();
-    uintmax_t file_pos = block_index * block_size;
-    
-    if (file_pos >= file_size) {
-        return "";
+
+    FileReader& reader = handle.get_reader();  // Откроет файл только сейчас!
+    if (!reader.is_open()) {
+        return false;
     }
-    
-    file.seekg(file_pos, std::ios::beg);
 
-    // Определяем сколько байт читать
-    uintmax_t bytes_to_read = std::min(block_size, file_size - file_pos);
-    
-    if (bytes_to_read == 0) {
-        return "";
+    // Последний блок короче S. Дополнять его нулями не нужно: сравниваются
+    // только файлы одного размера, длина хвоста у них одинакова.
+    length = static_cast<size_t>(std::min<uintmax_t>(block_size, file_size - offset));
+    return true;
+}
+
+void Hash::store_block_hash(FileHandle& handle, size_t block_index, const char* data,
+                            size_t length, uint8_t* digest) {
+    hash_block(data, length, digest);
+
+    if (cache) {
+        // Блоки выборки приходят не по порядку - храним хеш под номером блока
+        if (handle.known_hashes.digest_size() == 0) {
+            handle.known_hashes = KnownHashes(digest_size);
+        }
+        handle.known_hashes.add(block_index, digest);
     }
+}
 
-    // Читаем данные
-    std::vector<char> buffer(bytes_to_read);
-    file.read(buffer.data(), bytes_to_read);
-    std::streamsize bytes_read = file.gcount();
+bool Hash::get_block_hash(FileHandle& handle, size_t block_index, uint8_t* digest) {
+    if (lookup_block_hash(handle, block_index, digest)) {
+        return true;
+    }
 
-    if (bytes_read == 0) {
-        return "";
+    uintmax_t offset = 0;
+    size_t length = 0;
+    if (!locate_block(handle, block_index, offset, length)) {
+        return false;
+    }
+
+    // Данные берутся из окна чтения (или отображения) без копирования;
+    // nullptr - файл укоротился после сканирования
+    const char* data = handle.get_reader().read(offset, length);
+    if (!data) {
+        return false;
+    }
+
+    store_block_hash(handle, block_index, data, length, digest);
+    return true;
+}
+
+void Hash::read_block_digests(GroupJob& job, const std::vector<size_t>& members, size_t block,
+                              ReadContext& context) {
+    auto& handles = job.handles;
+    context.digests.resize(members.size() * digest_size);
+    context.ok.assign(members.size(), 0);
+
+    // Пачка читается одновременно: её дескрипторы и окна должны уложиться
+    // в доли потока
+    size_t chunk = descriptor_share();
+    if (memory_share() != 0) {
+        chunk = std::min(chunk, std::max<size_t>(memory_share() / read_options.read_size, 1));
+    }
+
+    if (read_options.async != AsyncEngine::none && !context.async) {
+        // Глубина очереди делится между потоками: вспомогательных потоков
+        // запасного механизма всего не больше --queue-depth
+        context.async = AsyncReader::create(read_options.async, queue_share());
     }
 
-    // Создаём полный блок размера S с нулями
-    std::vector<char> full_block(block_size, '\0');
-    std::copy(buffer.begin(), buffer.begin() + bytes_read, full_block.begin());
+    for (size_t begin = 0; begin < members.size(); begin += chunk) {
+        size_t end = std::min(members.size(), begin + chunk);
+        context.requests.clear();
+        context.request_slots.clear();
+        // Место под пачку освобождается заранее у давно не читавшихся файлов
+        enforce_budget(context.resident, end - begin);
+
+        for (size_t slot = begin; slot < end; ++slot) {
+            FileHandle& handle = *handles[members[slot]];
+            uint8_t* digest = context.digests.data() + slot * digest_size;
+            if (lookup_block_hash(handle, block, digest)) {
+                context.ok[slot] = 1;
+                ++context.hashing.cache_hits;
+                continue;
+            }
+            ++context.hashing.cache_misses;
+            uintmax_t offset = 0;
+            size_t length = 0;
+            if (!locate_block(handle, block, offset, length)) {
+                continue;
+            }
+            AsyncReader::Request request;
+            if (context.async && handle.get_reader().prepare_fetch(offset, length, request)) {
+                context.requests.push_back(request);
+                context.request_slots.push_back(slot);
+                continue;
+            }
+            // Данные уже в окне (или отображены) - читаем сразу
+            const char* data = handle.get_reader().read(offset, length);
+            if (data) {
+                store_block_hash(handle, block, data, length, digest);
+                context.ok[slot] = 1;
+            }
+        }
+
+        if (!context.requests.empty()) {
+            // Завершения приходят в любом порядке, в том числе из других потоков:
+            // каждый пишет только свой элемент, хешируем после пачки
+            context.request_bytes.assign(context.requests.size(), 0);
+            std::vector<size_t>& bytes = context.request_bytes;
+            context.async->run(context.requests, [&bytes](size_t index, size_t got) {
+                bytes[index] = got;
+            });
+            for (size_t i = 0; i < context.requests.size(); ++i) {
+                size_t slot = context.request_slots[i];
+                FileHandle& handle = *handles[members[slot]];
+                uintmax_t offset = static_cast<uintmax_t>(block) * block_size;
+                size_t length = static_cast<size_t>(
+                    std::min<uintmax_t>(block_size, handle.get_size() - offset));
+                const char* data = handle.get_reader().complete_fetch(
+                    context.requests[i], offset, length, bytes[i]);
+                if (data) {
+                    store_block_hash(handle, block, data, length,
+                                     context.digests.data() + slot * digest_size);
+                    context.ok[slot] = 1;
+                }
+            }
+        }
 
-    // Вычисляем хеш
-    std::string hash = hash_crc32(std::string(full_block.data(), block_size));
+        for (size_t slot = begin; slot < end; ++slot) {
+            context.resident.touch(*handles[members[slot]]);
+        }
+    }
+}
 
-    // Кэшируем результат
-    handle.block_cache[block_index] = hash;
-    return hash;
+void Hash::collect_stats(const ReadContext& context) {
+    if (stats) {
+        stats->add_tally(Phase::hashing, context.hashing);
+        stats->add_tally(Phase::comparison, context.comparison);
+        stats->add_rejected(context.rejected);
+    }
 }
 
 bool Hash::compare_handles_from_block(FileHandle& handle1, FileHandle& handle2,
@@ -139,78 +346,522 @@ bool Hash::compare_handles_from_block(FileHandle& handle1, FileHandle& handle2,
 
     // Сравниваем блок за блоком
     for (size_t block_idx = start_block; block_idx < total_blocks; block_idx++) {
-        std::string hash1 = get_block_hash(handle1, block_idx);
-        std::string hash2 = get_block_hash(handle2, block_idx);
+        uint8_t hash1[Hasher::max_digest_size];
+        uint8_t hash2[Hasher::max_digest_size];
 
-        if (hash1.empty() || hash2.empty()) {
+        if (!get_block_hash(handle1, block_idx, hash1) ||
+            !get_block_hash(handle2, block_idx, hash2)) {
             return false;
         }
 
-        if (hash1 != hash2) {
+        if (std::memcmp(hash1, hash2, digest_size) != 0) {
             return false;
         }
+
+        if (verify) {
+            const char* data1 = block_data(handle1, block_idx);
+            const char* data2 = block_data(handle2, block_idx);
+            uintmax_t offset = static_cast<uintmax_t>(block_idx) * block_size;
+            size_t length = static_cast<size_t>(
+                std::min<uintmax_t>(block_size, handle1.get_size() - offset));
+            if (!data1 || !data2 || std::memcmp(data1, data2, length) != 0) {
+                return false;
+            }
+        }
     }
 
     return true;
 }
 
-std::vector<std::vector<boost::filesystem::path>>
-Hash::find_real_duplicates_lazy(const std::vector<std::vector<boost::filesystem::path>>& size_groups) {
-    std::vector<std::vector<boost::filesystem::path>> result;
+std::vector<std::vector<size_t>> Hash::split_by_digest(const std::vector<size_t>& members,
+                                                       ReadContext& context) {
+    const uint8_t* digests = context.digests.data();
+    std::vector<size_t>& order = context.order;
+    order.resize(members.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    // Устойчивая сортировка по хешу: внутри частей файлы остаются по возрастанию
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return std::memcmp(digests + a * digest_size, digests + b * digest_size, digest_size) < 0;
+    });
+
+    std::vector<std::vector<size_t>> parts;
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (i == 0 || std::memcmp(digests + order[i - 1] * digest_size,
+                                  digests + order[i] * digest_size, digest_size) != 0) {
+            parts.emplace_back();
+        }
+        parts.back().push_back(members[order[i]]);
+    }
+    return parts;
+}
 
-    for (const auto& group : size_groups) {
-        if (group.size() < 2) continue;
+std::vector<Hash::Bucket> Hash::split_by_size(GroupJob& job) {
+    std::unordered_map<uintmax_t, size_t> index_by_size;
+    std::vector<Bucket> by_size;
+    for (size_t i = 0; i < job.handles.size(); ++i) {
+        FileHandle& handle = *job.handles[i];
+        if (!handle.is_valid()) {
+            release(handle);
+            continue;
+        }
+        auto inserted = index_by_size.emplace(handle.get_size(), by_size.size());
+        if (inserted.second) {
+            by_size.push_back(Bucket{{}, 0});
+        }
+        by_size[inserted.first->second].members.push_back(i);
+    }
 
-        // Вектор для отслеживания обработанных файлов
-        std::vector<bool> processed(group.size(), false);
+    std::vector<Bucket> buckets;
+    for (auto& bucket : by_size) {
+        if (bucket.members.size() > 1) {
+            buckets.push_back(std::move(bucket));
+        } else {
+            release(*job.handles[bucket.members.front()]);
+        }
+    }
+    return buckets;
+}
 
-        for (size_t i = 0; i < group.size(); ++i) {
-            if (processed[i]) continue;
+const char* Hash::block_data(FileHandle& handle, size_t block_index) {
+    uintmax_t offset = 0;
+    size_t length = 0;
+    if (!locate_block(handle, block_index, offset, length)) {
+        return nullptr;
+    }
+    // Блок только что захеширован - он ещё в окне, диск не читается.
+    // Заново читаются лишь блоки, хеш которых взят из кэша или вытеснен
+    // пределом памяти.
+    return handle.get_reader().read(offset, length);
+}
 
-            // Создаем FileHandle для текущего файла ТОЛЬКО СЕЙЧАС
-            std::unique_ptr<FileHandle> handle_i = std::make_unique<FileHandle>(group[i]);
-            if (!handle_i->is_valid()) {
-                processed[i] = true;
+std::vector<std::vector<size_t>> Hash::split_by_content(GroupJob& job,
+                                                        std::vector<std::vector<size_t>>&& parts,
+                                                        size_t block, ReadContext& context) {
+    auto& handles = job.handles;
+    uintmax_t offset = static_cast<uintmax_t>(block) * block_size;
+    std::vector<std::vector<size_t>> result;
+    result.reserve(parts.size());
+
+    for (auto& part : parts) {
+        if (part.size() < 2) {
+            result.push_back(std::move(part));
+            continue;
+        }
+        size_t length = static_cast<size_t>(
+            std::min<uintmax_t>(block_size, handles[part.front()]->get_size() - offset));
+
+        // Классы одинакового содержимого с копией блока первого файла каждого;
+        // при совпавшем хеше класс почти всегда один. Окна сравнённых файлов
+        // можно вытеснять - читается ровно один файл за раз.
+        size_t first = result.size();
+        size_t classes = 0;
+        for (size_t member : part) {
+            FileHandle& handle = *handles[member];
+            enforce_budget(context.resident, 1);
+            const char* data = block_data(handle, block);
+            context.resident.touch(handle);
+            if (!data) {
+                handle.close();
                 continue;
             }
+            size_t found = 0;
+            while (found < classes &&
+                   std::memcmp(context.representatives.data() + found * length, data, length) != 0) {
+                ++found;
+            }
+            if (found == classes) {
+                context.representatives.resize((classes + 1) * length);
+                std::memcpy(context.representatives.data() + classes * length, data, length);
+                ++classes;
+                result.emplace_back();
+            }
+            result[first + found].push_back(member);
+        }
+    }
+    return result;
+}
+
+void Hash::collapse_same_files(SizeGroups::Span group, const PathStore& paths,
+                               GroupJob& job) {
+    std::map<std::pair<uint64_t, uint64_t>, size_t> by_identity;
+    // Пути уже принятых ссылок на inode (по номеру файла в job) - каждый путь
+    // собирается один раз; заводятся только для inode с несколькими путями
+    std::unordered_map<size_t, std::unordered_set<std::string>> alias_paths;
+    job.handles.reserve(group.size());
+    for (size_t i = 0; i < group.size(); ++i) {
+        const FileRecord& file = group[i];
+        if (file.has_identity()) {
+            auto found = by_identity.find(std::make_pair(file.device, file.inode));
+            if (found != by_identity.end()) {
+                std::vector<size_t>& aliases = job.paths[found->second];
+                std::unordered_set<std::string>& seen = alias_paths[found->second];
+                if (seen.empty()) {
+                    std::string first;
+                    paths.append_path(group[aliases.front()].id, first);
+                    seen.insert(std::move(first));
+                }
+                // Один и тот же путь из пересекающихся корней - не дубликат
+                std::string file_path;
+                paths.append_path(file.id, file_path);
+                if (seen.insert(std::move(file_path)).second) {
+                    aliases.push_back(i);
+                }
+                continue;
+            }
+            by_identity.emplace(std::make_pair(file.device, file.inode), job.handles.size());
+        }
+        job.handles.push_back(std::make_unique<FileHandle>(file, read_options, paths));
+        job.paths.push_back({i});
+
+        // Начало файла уже прочитано конвейером (prefetch к этому моменту завершён)
+        if (!primed.empty() && file.has_identity()) {
+            auto found = primed.find(std::make_pair(file.device, file.inode));
+            if (found != primed.end()) {
+                FileHandle& handle = *job.handles.back();
+                handle.known_hashes = std::move(found->second);
+                handle.cache_loaded = true;  // Постоянный кэш prefetch уже проверил
+                primed.erase(found);
+            }
+        }
+    }
+}
+
+void Hash::prefetch(const FileRecord& record, const PathStore& paths) {
+    if (record.size == 0 || !record.has_identity()) {
+        return;
+    }
+    auto identity = std::make_pair(record.device, record.inode);
+    {
+        // Жёсткие ссылки на уже прочитанный файл не читаем повторно
+        std::lock_guard<std::mutex> lock(primed_mutex);
+        if (!primed.emplace(identity, KnownHashes()).second) {
+            return;
+        }
+    }
+
+    KnownHashes digests(digest_size);
+    if (cache) {
+        digests = cache->lookup(record);
+    }
+    // Блоки первого окна чтения - они приходят одним системным вызовом
+    size_t total_blocks = static_cast<size_t>((record.size + block_size - 1) / block_size);
+    size_t wanted = std::min(total_blocks, std::max<size_t>(read_options.read_size / block_size, 1));
+    size_t known = digests.prefix_count();
+    PhaseTally tally;
+    tally.cache_hits = std::min(known, wanted);
+    if (known < wanted) {
+        tally.cache_misses = wanted - known;
+        Stats::Stopwatch timing(stats ? &tally : nullptr);
+        FileReader reader(paths.path(record.id), record.size, read_options);
+        std::vector<uint8_t> digest(digest_size);
+        for (size_t block = known; block < wanted && reader.open(); ++block) {
+            uintmax_t offset = static_cast<uintmax_t>(block) * block_size;
+            size_t length = static_cast<size_t>(std::min<uintmax_t>(block_size, record.size - offset));
+            const char* data = reader.read(offset, length);
+            if (!data) {
+                break;
+            }
+            hash_block(data, length, digest.data());
+            digests.add(block, digest.data());
+        }
+    }
 
-            // Группа дубликатов для текущего файла
-            std::vector<boost::filesystem::path> duplicate_group;
-            duplicate_group.push_back(group[i]);
+    if (stats) {
+        stats->add_tally(Phase::hashing, tally);
+    }
 
-            // Сравниваем с остальными файлами
-            for (size_t j = i + 1; j < group.size(); ++j) {
-                if (processed[j]) continue;
+    std::lock_guard<std::mutex> lock(primed_mutex);
+    primed[identity] = std::move(digests);
+}
 
-                // Создаем FileHandle для второго файла ТОЛЬКО СЕЙЧАС
-                std::unique_ptr<FileHandle> handle_j = std::make_unique<FileHandle>(group[j]);
-                if (!handle_j->is_valid()) {
-                    processed[j] = true;
+std::vector<size_t> Hash::sample_blocks(size_t total_blocks) const {
+    std::vector<size_t> sampled;
+    if (total_blocks == 0 || samples == 0) {
+        return sampled;  // Без выборки - строго последовательное сравнение
+    }
+    sampled.push_back(0);
+    if (total_blocks > 1) {
+        sampled.push_back(total_blocks - 1);
+    }
+    for (size_t i = 1; i <= samples; ++i) {
+        size_t block = static_cast<size_t>(static_cast<uintmax_t>(total_blocks) * i / (samples + 1));
+        if (std::find(sampled.begin(), sampled.end(), block) == sampled.end()) {
+            sampled.push_back(block);
+        }
+    }
+    return sampled;
+}
+
+size_t Hash::block_at(const std::vector<size_t>& sampled, size_t step) {
+    if (step < sampled.size()) {
+        return sampled[step];
+    }
+    // Шаг после выборки - k-й блок, не вошедший в выборку:
+    // наименьший block, для которого block = k + (число выбранных блоков <= block)
+    size_t k = step - sampled.size();
+    size_t block = k;
+    for (;;) {
+        size_t skipped = static_cast<size_t>(std::count_if(sampled.begin(), sampled.end(),
+                                                           [block](size_t s) { return s <= block; }));
+        if (k + skipped == block) {
+            return block;
+        }
+        block = k + skipped;
+    }
+}
+
+void Hash::partition_bucket(GroupJob& job, Bucket bucket, ReadContext& context,
+                            ThreadPool* pool, std::vector<ReadContext>* contexts) {
+    // Корзины меньше этого размера не стоят накладных расходов на передачу в пул
+    const size_t parallel_bucket_threshold = 64;
+
+    auto& handles = job.handles;
+    std::vector<Bucket> pending;
+    pending.push_back(std::move(bucket));
+
+    // Обход в глубину без рекурсии: число блоков может быть очень большим
+    while (!pending.empty()) {
+        Bucket current = std::move(pending.back());
+        pending.pop_back();
+
+        uintmax_t file_size = handles[current.members.front()]->get_size();
+        size_t total_blocks = (file_size + block_size - 1) / block_size;
+        std::vector<size_t> sampled = sample_blocks(total_blocks);
+
+        while (current.members.size() > 1 && current.step < total_blocks) {
+            size_t block = block_at(sampled, current.step);
+            {
+                // Читаем блок каждого оставшегося кандидата ровно один раз
+                Stats::Stopwatch timing(stats ? &context.hashing : nullptr);
+                read_block_digests(job, current.members, block, context);
+            }
+            Stats::Stopwatch timing(stats ? &context.comparison : nullptr);
+            std::vector<size_t> readable;
+            readable.reserve(current.members.size());
+            for (size_t slot = 0; slot < current.members.size(); ++slot) {
+                size_t member = current.members[slot];
+                if (!context.ok[slot]) {
+                    handles[member]->close();  // Файл не читается - его хешам нельзя доверять
                     continue;
                 }
+                // Сдвигаем хеш на место файла среди прочитанных
+                if (readable.size() != slot) {
+                    std::memcpy(context.digests.data() + readable.size() * digest_size,
+                                context.digests.data() + slot * digest_size, digest_size);
+                }
+                readable.push_back(member);
+            }
+            std::vector<std::vector<size_t>> split = split_by_digest(readable, context);
+            if (verify) {
+                split = split_by_content(job, std::move(split), block, context);
+            }
+            if (read_options.memory_limit != 0) {
+                // Сначала дорабатываются меньшие корзины: их файлы быстрее
+                // выбывают и освобождают окна
+                std::stable_sort(split.begin(), split.end(),
+                                 [](const std::vector<size_t>& a, const std::vector<size_t>& b) {
+                                     return a.size() < b.size();
+                                 });
+            }
 
-                // Сравниваем файлы
-                if (compare_handles_from_block(*handle_i, *handle_j, 0)) {
-                    duplicate_group.push_back(group[j]);
-                    processed[j] = true;
-                    // Закрываем поток второго файла, так как он больше не понадобится
-                    handle_j->close_stream();
+            ++current.step;
+            current.members.clear();
+            size_t first_pending = pending.size();
+            for (auto& part : split) {
+                if (part.size() < 2) {
+                    // Уникальное содержимое - файл выбывает из сравнения
+                    release(*handles[part.front()]);
+                    if (stats) {
+                        ++context.rejected[block];
+                    }
+                } else if (current.members.empty()) {
+                    current.members = std::move(part);
+                } else if (pool && part.size() >= parallel_bucket_threshold) {
+                    // Файлы переходят к другому потоку - снимаем их с учёта этого
+                    for (size_t member : part) {
+                        ResidentSet::forget(*handles[member]);
+                    }
+                    Bucket stolen{std::move(part), current.step};
+                    ++job.active;
+                    pool->submit([this, &job, stolen, pool, contexts]() mutable {
+                        ReadContext& worker_context = (*contexts)[pool->current_worker()];
+                        partition_bucket(job, std::move(stolen), worker_context, pool, contexts);
+                        leave_job(job);
+                    });
                 } else {
-                    // Закрываем поток второго файла, чтобы не держать открытым
-                    handle_j->close_stream();
+                    pending.push_back(Bucket{std::move(part), current.step});
                 }
             }
+            if (read_options.memory_limit != 0) {
+                // pending - стек: меньшая из отложенных корзин должна оказаться сверху
+                std::reverse(pending.begin() + static_cast<std::ptrdiff_t>(first_pending),
+                             pending.end());
+            }
+        }
+
+        if (current.members.size() > 1) {
+            Stats::Stopwatch timing(stats ? &context.comparison : nullptr);
+            for (size_t member : current.members) {
+                release(*handles[member]);
+            }
+            std::lock_guard<std::mutex> lock(job.mutex);
+            job.groups.push_back(std::move(current.members));
+        }
+    }
+}
+
+void Hash::leave_job(GroupJob& job) {
+    if (job.active.fetch_sub(1) == 1) {
+        job.on_done();
+    }
+}
+
+void Hash::emit_groups(GroupJob& job, SizeGroups::Span group, const PathStore& paths,
+                       const GroupSink& on_group) {
+    // Детерминированная сборка: внутри группы размера - по первому файлу,
+    // как при попарном сравнении
+    std::vector<std::vector<size_t>> groups;
+    std::vector<bool> grouped(job.handles.size(), false);
+    for (const auto& members : job.groups) {
+        std::vector<size_t> indices;
+        for (size_t member : members) {
+            grouped[member] = true;
+            const std::vector<size_t>& aliases = job.paths[member];
+            if (report_hardlinks) {
+                indices.insert(indices.end(), aliases.begin(), aliases.end());
+            } else {
+                indices.push_back(aliases.front());
+            }
+        }
+        std::sort(indices.begin(), indices.end());
+        groups.push_back(std::move(indices));
+    }
+    // Жёсткие ссылки без других копий - группа без единого чтения содержимого
+    if (report_hardlinks) {
+        for (size_t h = 0; h < job.paths.size(); ++h) {
+            const std::vector<size_t>& aliases = job.paths[h];
+            if (!grouped[h] && aliases.size() > 1 && group[aliases.front()].size > 0) {
+                groups.push_back(aliases);
+            }
+        }
+    }
 
-            // Если нашли дубликаты
-            if (duplicate_group.size() > 1) {
-                result.push_back(std::move(duplicate_group));
+    std::sort(groups.begin(), groups.end(),
+              [](const std::vector<size_t>& a, const std::vector<size_t>& b) {
+                  return a.front() < b.front();
+              });
+
+    // Файлы группы больше не нужны - память освобождается до разбора следующих
+    job.handles.clear();
+    job.handles.shrink_to_fit();
+    job.paths.clear();
+    job.paths.shrink_to_fit();
+    job.groups.clear();
+    job.groups.shrink_to_fit();
+
+    for (const auto& indices : groups) {
+        DuplicateGroup duplicate_group;
+        duplicate_group.size = group[indices.front()].size;
+        duplicate_group.files.reserve(indices.size());
+        for (size_t index : indices) {
+            // Полные пути собираются только для вывода
+            const FileRecord& file = group[index];
+            duplicate_group.files.push_back(
+                DuplicateFile{paths.path(file.id), file.device, file.inode, file.mtime});
+        }
+        on_group(std::move(duplicate_group));
+    }
+}
+
+void Hash::find_real_duplicates_lazy(const SizeGroups& size_groups, const PathStore& paths,
+                                     const GroupSink& on_group) {
+    // Один FileHandle на файл (inode) на всё время разбиения группы
+    std::vector<std::unique_ptr<GroupJob>> jobs;
+    jobs.reserve(size_groups.size());
+    for (size_t g = 0; g < size_groups.size(); ++g) {
+        SizeGroups::Span group = size_groups[g];
+        auto job = std::make_unique<GroupJob>();
+        if (group.size() >= 2) {
+            collapse_same_files(group, paths, *job);
+        }
+        jobs.push_back(std::move(job));
+    }
+
+    // Группы размера выводятся по порядку: готовая группа ждёт, пока
+    // не будут разобраны все предыдущие
+    std::mutex emit_mutex;
+    std::vector<char> finished(jobs.size(), 0);
+    size_t next_to_emit = 0;
+    for (size_t g = 0; g < jobs.size(); ++g) {
+        jobs[g]->on_done = [&, g]() {
+            std::lock_guard<std::mutex> lock(emit_mutex);
+            finished[g] = 1;
+            while (next_to_emit < jobs.size() && finished[next_to_emit]) {
+                emit_groups(*jobs[next_to_emit], size_groups[next_to_emit], paths, on_group);
+                ++next_to_emit;
             }
+        };
+    }
 
-            processed[i] = true;
-            // Закрываем поток текущего файла
-            handle_i->close_stream();
+    if (threads <= 1) {
+        ReadContext context;
+        for (auto& job : jobs) {
+            for (auto& bucket : split_by_size(*job)) {
+                partition_bucket(*job, std::move(bucket), context, nullptr, nullptr);
+            }
+            job->on_done();
         }
+        collect_stats(context);
+    } else {
+        ThreadPool pool(threads);
+        std::vector<ReadContext> contexts(pool.size());
+        // Крупные группы первыми: они дольше всех и их корзины дробятся дальше
+        std::vector<size_t> order(jobs.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return jobs[a]->handles.size() > jobs[b]->handles.size();
+        });
+        for (size_t index : order) {
+            GroupJob* job = jobs[index].get();
+            if (job->handles.size() < 2) {
+                job->on_done();  // Сравнивать нечего, но жёсткие ссылки выводятся
+                continue;
+            }
+            job->active = 1;
+            pool.submit([this, job, &pool, &contexts]() {
+                ReadContext& context = contexts[pool.current_worker()];
+                for (auto& bucket : split_by_size(*job)) {
+                    partition_bucket(*job, std::move(bucket), context, &pool, &contexts);
+                }
+                leave_job(*job);
+            });
+        }
+        pool.wait();
+        for (const ReadContext& context : contexts) {
+            collect_stats(context);
+        }
+    }
+    if (stats) {
+        stats->mark_peak_rss(Phase::hashing);
+        stats->mark_peak_rss(Phase::comparison);
     }
+}
 
+std::vector<std::vector<boost::filesystem::path>>
+Hash::find_real_duplicates_lazy(const SizeGroups& size_groups,
+                                const PathStore& paths) {
+    std::vector<std::vector<boost::filesystem::path>> result;
+    find_real_duplicates_lazy(size_groups, paths, [&result](DuplicateGroup&& group) {
+        std::vector<boost::filesystem::path> duplicate_group;
+        duplicate_group.reserve(group.files.size());
+        for (DuplicateFile& file : group.files) {
+            duplicate_group.push_back(std::move(file.path));
+        }
+        result.push_back(std::move(duplicate_group));
+    });
     return result;
-}
\ No newline at end of file
+}
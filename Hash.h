@@ -1,49 +1,258 @@
 #pragma once
 
 #include <boost/filesystem.hpp>
+#include <atomic>
+#include <functional>
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <cstdint>
 #include <memory>
-#include <fstream>
+#include <list>
+#include <map>
+#include <mutex>
+#include "DuplicateGroup.h"
+#include "FileRecord.h"
+#include "Hasher.h"
+#include "FileReader.h"
+#include "KnownHashes.h"
+#include "PathStore.h"
+#include "SizeGroups.h"
+#include "Stats.h"
+
+class ThreadPool;
+class BlockCache;
 
 class Hash {
+    // Микробенчмарки (bench/) вызывают внутренние методы напрямую
+    friend class HashBenchmark;
+
 private:
     size_t block_size;
+    const Hasher& hasher;
+    Hasher::BlockKernel block_kernel;                      // Ядро для полных блоков (nullptr - hasher.hash)
+    size_t digest_size;
+    size_t threads;
+    ReadOptions read_options;                              // Способ чтения файлов
+    BlockCache* cache;                                     // Постоянный кэш хешей (может отсутствовать)
+    size_t samples;                                        // Число внутренних блоков предварительной выборки
+    bool report_hardlinks;                                 // Выводить все пути одного inode, а не только первый
+    Stats* stats;                                          // Счётчики --stats (может отсутствовать)
+    bool verify;                                           // Сверять содержимое блоков побайтно (--verify)
+
+    // Хеши начала файлов, прочитанные конвейером во время сканирования (см. prefetch)
+    std::mutex primed_mutex;
+    std::map<std::pair<uint64_t, uint64_t>, KnownHashes> primed;
 
-    // Структура для хранения информации о файле
+    struct ResidentSet;
+
+    // Структура для хранения информации о файле.
+    // Изменяемые кэши не защищены мьютексом: в каждый момент файл принадлежит
+    // ровно одной корзине разбиения, а корзину обрабатывает один поток.
     struct FileHandle {
-        boost::filesystem::path path;                      // Путь к файлу
-        mutable uintmax_t size;                            // Размер файла (ленивое чтение)
-        mutable std::unique_ptr<std::ifstream> stream;     // Поток для чтения (ленивое открытие)
-        mutable std::unordered_map<size_t, std::string> block_cache;  // Кэш вычисленных хешей блоков
-    
-        FileHandle(const boost::filesystem::path& file_path);
-    
+        FileRecord record;                                 // Путь, размер и идентичность файла (из сканирования)
+        const ReadOptions* read_options;                   // Параметры чтения (общие для всех файлов)
+        const PathStore* paths;                            // Хранилище путей (путь собирается при открытии)
+        mutable std::unique_ptr<FileReader> reader;        // Чтение содержимого (ленивое открытие)
+        mutable KnownHashes known_hashes;                  // Хеши прочитанных блоков (только с постоянным кэшем)
+        mutable bool cache_loaded;                         // known_hashes уже загружены из постоянного кэша
+
+        // Учёт ресурсов в потоке, который сейчас читает файл (см. ResidentSet)
+        ResidentSet* resident;
+        std::list<FileHandle*>::iterator resident_position;
+        bool charged_descriptor;                           // Учтённые в resident дескриптор и память
+        size_t charged_bytes;
+
+        FileHandle(const FileRecord& record, const ReadOptions& options, const PathStore& paths);
+
         // Ленивые методы доступа
         uintmax_t get_size() const;
-        std::ifstream& get_stream() const;
+        FileReader& get_reader() const;
         void ensure_opened() const;
-        void close_stream();
-        
+        void close_reader();
+
         bool is_valid() const;
         void close();
     };
 
-    // Хеш-функция CRC32
-    std::string hash_crc32(const std::string &data);
-    
-    // Получить хеш блока (с ленивым чтением и кэшированием)
-    std::string get_block_hash(FileHandle& handle, size_t block_index);
-    
+    // Файлы, ресурсы которых (дескриптор или отображение, окно чтения, хеши
+    // блоков) удерживает один поток, - от недавно читавшихся к давним.
+    // Когда доля потока в --max-open-files или --memory-limit превышена,
+    // ресурсы давних файлов освобождаются; их следующее чтение откроет файл
+    // заново. Файл учитывается не больше чем в одном наборе: при передаче
+    // корзины другому потоку её файлы снимаются с учёта.
+    struct ResidentSet {
+        std::list<FileHandle*> order;
+        size_t descriptors = 0;
+        size_t bytes = 0;
+
+        ResidentSet() = default;
+        ResidentSet(const ResidentSet&) = delete;
+        ResidentSet& operator=(const ResidentSet&) = delete;
+        ~ResidentSet();
+
+        // Поднять файл в начало и пересчитать его ресурсы
+        void touch(FileHandle& handle);
+        // Пересчитать ресурсы файла, не меняя его места
+        void recharge(FileHandle& handle);
+        // Снять файл с учёта (ресурсы остаются у файла)
+        static void forget(FileHandle& handle);
+    };
+
+    // Состояние потока-обработчика: переиспользуемые буферы хешей
+    struct ReadContext {
+        std::vector<uint8_t> digests;                      // Хеши блока для всех файлов корзины
+        std::vector<size_t> order;                         // Порядок файлов корзины по хешу
+        std::unique_ptr<AsyncReader> async;                // Пакетное чтение (создаётся при первом использовании)
+        std::vector<AsyncReader::Request> requests;        // Запросы текущей пачки
+        std::vector<size_t> request_slots;                 // Позиция файла в корзине для каждого запроса
+        std::vector<size_t> request_bytes;                 // Прочитано байт по каждому запросу
+        std::vector<char> ok;                              // Блок файла прочитан и захеширован
+        std::vector<char> representatives;                 // Копии блоков классов содержимого (--verify)
+        ResidentSet resident;                              // Открытые файлы и окна потока
+        PhaseTally hashing;                                // Статистика потока (только с --stats)
+        PhaseTally comparison;
+        std::map<size_t, uint64_t> rejected;               // Номер блока -> файлов отсеяно на нём
+    };
+
+    // Корзина кандидатов: индексы файлов и номер следующего шага порядка
+    // сравнения блоков (см. block_order)
+    struct Bucket {
+        std::vector<size_t> members;
+        size_t step;
+    };
+
+    // Разбиение одной группы одинакового размера
+    struct GroupJob {
+        std::vector<std::unique_ptr<FileHandle>> handles;
+        std::vector<std::vector<size_t>> paths;            // Пути каждого файла (индексы в группе размера): сам файл и его жёсткие ссылки
+        std::mutex mutex;                                  // Защищает groups
+        std::vector<std::vector<size_t>> groups;           // Найденные группы дубликатов
+        std::atomic<size_t> active{0};                     // Незавершённые задачи пула по группе
+        std::function<void()> on_done;                     // Вызывается после последней задачи
+    };
+
+    // Задача пула по группе завершена; последняя вызывает job.on_done
+    static void leave_job(GroupJob& job);
+
+    // Собрать группы дубликатов одной группы размера в порядке первого
+    // файла и передать в on_group; затем освободить файлы группы
+    void emit_groups(GroupJob& job, SizeGroups::Span group, const PathStore& paths,
+                     const std::function<void(DuplicateGroup&&)>& on_group);
+
+    // Сохранить известные хеши файла в постоянный кэш и закрыть его
+    void release(FileHandle& handle);
+
+    // Доли потока в пределах дескрипторов, памяти (0 - без предела)
+    // и глубины асинхронной очереди
+    size_t descriptor_share() const;
+    size_t memory_share() const;
+    size_t queue_share() const;
+
+    // Освободить ресурсы давно не читавшихся файлов, пока набор потока
+    // вместе с reserve_files новыми файлами не уложится в свои доли
+    void enforce_budget(ResidentSet& resident, size_t reserve_files);
+
+    // Хеш блока из известных (в том числе из постоянного кэша) без чтения файла
+    bool lookup_block_hash(FileHandle& handle, size_t block_index, uint8_t* digest);
+
+    // Смещение и длина блока; false, если блока нет или файл не открывается
+    bool locate_block(FileHandle& handle, size_t block_index, uintmax_t& offset, size_t& length);
+
+    // Хеш данных блока: полный блок - специализированным ядром, хвост файла - hasher.hash
+    void hash_block(const char* data, size_t length, uint8_t* digest) const {
+        if (block_kernel && length == block_size) {
+            block_kernel(data, digest);
+        } else {
+            hasher.hash(data, length, digest);
+        }
+    }
+
+    // Захешировать прочитанный блок и запомнить хеш для постоянного кэша
+    void store_block_hash(FileHandle& handle, size_t block_index, const char* data,
+                          size_t length, uint8_t* digest);
+
+    // Получить хеш блока (с ленивым чтением и кэшированием) - digest_size байт в digest.
+    // Возвращает false, если блок не удалось прочитать.
+    bool get_block_hash(FileHandle& handle, size_t block_index, uint8_t* digest);
+
+    // Хеши блока block для файлов members - в context.digests подряд, по месту
+    // файла в members; context.ok отмечает успешно прочитанные. Файлы читаются
+    // пачками не больше предела дескрипторов, с асинхронным механизмом -
+    // одновременно всей пачкой.
+    void read_block_digests(GroupJob& job, const std::vector<size_t>& members, size_t block,
+                            ReadContext& context);
+
+    // Разложить файлы корзины по одинаковым хешам блока (digests - хеши подряд
+    // в порядке members); порядок файлов внутри частей сохраняется
+    std::vector<std::vector<size_t>> split_by_digest(const std::vector<size_t>& members,
+                                                     ReadContext& context);
+
+    // Данные блока из окна чтения файла; nullptr, если блок не читается
+    const char* block_data(FileHandle& handle, size_t block_index);
+
+    // Разложить части с одинаковым хешем блока по точному совпадению байт
+    // (--verify); нечитаемые файлы закрываются и выбывают. Блок первого
+    // файла каждого класса копируется, поэтому файлы читаются по одному
+    // в пределах долей потока
+    std::vector<std::vector<size_t>> split_by_content(GroupJob& job,
+                                                      std::vector<std::vector<size_t>>&& parts,
+                                                      size_t block, ReadContext& context);
+
+    // Передать статистику потока в stats
+    void collect_stats(const ReadContext& context);
+
     // Сравнить два файла, начиная с определенного блока
     bool compare_handles_from_block(FileHandle& handle1, FileHandle& handle2,
                                    size_t start_block = 0);
 
+    // Первое разбиение группы - по размеру (отсеивает пустые файлы)
+    std::vector<Bucket> split_by_size(GroupJob& job);
+
+    // Свернуть пути одного inode (жёсткие ссылки, пересекающиеся корни) в один
+    // файл: его содержимое читается один раз, а сами пути заведомо одинаковы
+    void collapse_same_files(SizeGroups::Span group, const PathStore& paths,
+                             GroupJob& job);
+
+    // Порядок сравнения блоков файла из total_blocks блоков: сначала выборка -
+    // первый, последний и samples внутренних блоков на равных расстояниях,
+    // затем остальные блоки по возрастанию. Различающиеся файлы с длинным
+    // общим заголовком отсеиваются за несколько чтений, а полная проверка
+    // выживших по-прежнему охватывает каждый блок.
+    std::vector<size_t> sample_blocks(size_t total_blocks) const;
+    static size_t block_at(const std::vector<size_t>& sampled, size_t step);
+
+    // Разбить корзину на группы дубликатов: блок k каждого файла читается
+    // один раз, файлы раскладываются по корзинам с одинаковым хешем блока,
+    // корзины из одного файла сразу отбрасываются.
+    // Крупные корзины при наличии пула отдаются другим потокам.
+    void partition_bucket(GroupJob& job, Bucket bucket, ReadContext& context,
+                          ThreadPool* pool, std::vector<ReadContext>* contexts);
+
 public:
-    Hash(size_t block_size);
-    
-    // Основной метод - находит настоящие дубликаты с ленивым чтением
+    Hash(size_t block_size, const Hasher& hasher, size_t threads = 1, BlockCache* cache = nullptr,
+         const ReadOptions& read_options = ReadOptions(), size_t samples = 3,
+         bool report_hardlinks = true, Stats* stats = nullptr, bool verify = false);
+
+    // Прочитать первое окно файла-кандидата и запомнить хеши его блоков
+    // (для небольших файлов - всех). Вызывается из потоков конвейера, пока
+    // сканирование ещё идёт; find_real_duplicates_lazy берёт эти хеши вместо
+    // повторного чтения. Файлы без известного inode пропускаются.
+    void prefetch(const FileRecord& record, const PathStore& paths);
+
+    // Получатель подтверждённых групп: вызывается из любого потока,
+    // но не одновременно
+    using GroupSink = std::function<void(DuplicateGroup&&)>;
+
+    // Основной метод - находит настоящие дубликаты с ленивым чтением.
+    // Группы передаются в on_group, как только разобраны их группа размера
+    // и все предыдущие: порядок не зависит от числа потоков, а файлы
+    // выведенных групп сразу освобождаются.
+    void find_real_duplicates_lazy(const SizeGroups& size_groups, const PathStore& paths,
+                                   const GroupSink& on_group);
+
+    // То же с накоплением путей всех групп
     std::vector<std::vector<boost::filesystem::path>>
-    find_real_duplicates_lazy(const std::vector<std::vector<boost::filesystem::path>>& size_groups);
-};
\ No newline at end of file
+    find_real_duplicates_lazy(const SizeGroups& size_groups,
+                              const PathStore& paths);
+};
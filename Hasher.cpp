@@ -0,0 +1,548 @@
+#include "Hasher.h"
+#include <boost/crc.hpp>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BAYAN_HAVE_SSE42_DISPATCH 1
+#include <nmmintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BAYAN_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define BAYAN_ALWAYS_INLINE inline
+#endif
+
+namespace {
+
+    // Ядро Impl::fixed<N> для поддерживаемого размера блока. С длиной,
+    // известной при компиляции, внутренние циклы разворачиваются, а ветки
+    // обработки хвоста исчезают.
+    template <typename Impl>
+    Hasher::BlockKernel fixed_kernel(size_t block_size) {
+        switch (block_size) {
+            case size_t(4) << 10: return &Impl::template fixed<size_t(4) << 10>;
+            case size_t(8) << 10: return &Impl::template fixed<size_t(8) << 10>;
+            case size_t(16) << 10: return &Impl::template fixed<size_t(16) << 10>;
+            case size_t(32) << 10: return &Impl::template fixed<size_t(32) << 10>;
+            case size_t(64) << 10: return &Impl::template fixed<size_t(64) << 10>;
+            case size_t(128) << 10: return &Impl::template fixed<size_t(128) << 10>;
+            case size_t(256) << 10: return &Impl::template fixed<size_t(256) << 10>;
+            case size_t(512) << 10: return &Impl::template fixed<size_t(512) << 10>;
+            case size_t(1) << 20: return &Impl::template fixed<size_t(1) << 20>;
+            default: return nullptr;
+        }
+    }
+
+    uint32_t rotl32(uint32_t value, int bits) {
+        return (value << bits) | (value >> (32 - bits));
+    }
+
+    uint32_t rotr32(uint32_t value, int bits) {
+        return (value >> bits) | (value << (32 - bits));
+    }
+
+    uint64_t rotl64(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    uint32_t load_le32(const char* data) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+        return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+               static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+    }
+
+    uint64_t load_le64(const char* data) {
+        return static_cast<uint64_t>(load_le32(data)) |
+               static_cast<uint64_t>(load_le32(data + 4)) << 32;
+    }
+
+    uint32_t load_be32(const unsigned char* p) {
+        return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 |
+               static_cast<uint32_t>(p[2]) << 8 | static_cast<uint32_t>(p[3]);
+    }
+
+    void store_le32(uint32_t value, uint8_t* out) {
+        for (int i = 0; i < 4; ++i) {
+            out[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    void store_be32(uint32_t value, uint8_t* out) {
+        for (int i = 0; i < 4; ++i) {
+            out[i] = static_cast<uint8_t>(value >> (24 - 8 * i));
+        }
+    }
+
+    // Дополнение по схеме Меркла-Дамгора (MD5, SHA-256): обработать полные
+    // 64-байтовые блоки, затем хвост с 0x80, нулями и длиной в битах
+    template <typename Compress>
+    void merkle_damgard(const char* data, size_t size, bool big_endian_length, Compress compress) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+        size_t full = size - size % 64;
+        for (size_t offset = 0; offset < full; offset += 64) {
+            compress(bytes + offset);
+        }
+
+        unsigned char tail[128] = {};
+        size_t rest = size - full;
+        if (rest > 0) {
+            std::memcpy(tail, bytes + full, rest);
+        }
+        tail[rest] = 0x80;
+        size_t tail_size = rest + 9 > 64 ? 128 : 64;
+        uint64_t bits = static_cast<uint64_t>(size) * 8;
+        for (int i = 0; i < 8; ++i) {
+            int shift = big_endian_length ? 56 - 8 * i : 8 * i;
+            tail[tail_size - 8 + i] = static_cast<unsigned char>(bits >> shift);
+        }
+        compress(tail);
+        if (tail_size == 128) {
+            compress(tail + 64);
+        }
+    }
+
+    // CRC32 (IEEE 802.3) - табличная реализация Boost
+    class Crc32Hasher : public Hasher {
+    public:
+        const char* name() const override { return "crc32"; }
+        size_t digest_size() const override { return 4; }
+
+        static BAYAN_ALWAYS_INLINE void compute(const char* data, size_t size, uint8_t* digest) {
+            boost::crc_32_type crc;
+            crc.process_bytes(data, size);
+            store_be32(crc.checksum(), digest);
+        }
+
+        void hash(const char* data, size_t size, uint8_t* digest) const override {
+            compute(data, size, digest);
+        }
+
+        template <size_t Size>
+        static void fixed(const char* data, uint8_t* digest) {
+            compute(data, Size, digest);
+        }
+
+        BlockKernel block_kernel(size_t block_size) const override {
+            return fixed_kernel<Crc32Hasher>(block_size);
+        }
+
+    };
+
+    // CRC32C (Castagnoli): инструкция SSE4.2 или программный slicing-by-8
+    class Crc32cHasher : public Hasher {
+    private:
+        using Kernel = uint32_t (*)(uint32_t crc, const char* data, size_t size);
+
+        static uint32_t table_[8][256];
+        Kernel kernel_;
+
+        static void init_table() {
+            static bool initialized = [] {
+                for (uint32_t i = 0; i < 256; ++i) {
+                    uint32_t crc = i;
+                    for (int bit = 0; bit < 8; ++bit) {
+                        crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+                    }
+                    table_[0][i] = crc;
+                }
+                for (uint32_t i = 0; i < 256; ++i) {
+                    for (int slice = 1; slice < 8; ++slice) {
+                        uint32_t prev = table_[slice - 1][i];
+                        table_[slice][i] = (prev >> 8) ^ table_[0][prev & 0xFF];
+                    }
+                }
+                return true;
+            }();
+            (void)initialized;
+        }
+
+        static BAYAN_ALWAYS_INLINE uint32_t software(uint32_t crc, const char* data, size_t size) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+            while (size >= 8) {
+                uint32_t low = crc ^ load_le32(reinterpret_cast<const char*>(p));
+                uint32_t high = load_le32(reinterpret_cast<const char*>(p + 4));
+                crc = table_[7][low & 0xFF] ^ table_[6][(low >> 8) & 0xFF] ^
+                      table_[5][(low >> 16) & 0xFF] ^ table_[4][low >> 24] ^
+                      table_[3][high & 0xFF] ^ table_[2][(high >> 8) & 0xFF] ^
+                      table_[1][(high >> 16) & 0xFF] ^ table_[0][high >> 24];
+                p += 8;
+                size -= 8;
+            }
+            while (size-- > 0) {
+                crc = (crc >> 8) ^ table_[0][(crc ^ *p++) & 0xFF];
+            }
+            return crc;
+        }
+
+#ifdef BAYAN_HAVE_SSE42_DISPATCH
+        __attribute__((target("sse4.2")))
+        static BAYAN_ALWAYS_INLINE uint32_t hardware(uint32_t crc, const char* data, size_t size) {
+#if defined(__x86_64__)
+            uint64_t crc64 = crc;
+            while (size >= 8) {
+                uint64_t word;
+                std::memcpy(&word, data, sizeof(word));
+                crc64 = _mm_crc32_u64(crc64, word);
+                data += 8;
+                size -= 8;
+            }
+            crc = static_cast<uint32_t>(crc64);
+#endif
+            while (size >= 4) {
+                uint32_t word;
+                std::memcpy(&word, data, sizeof(word));
+                crc = _mm_crc32_u32(crc, word);
+                data += 4;
+                size -= 4;
+            }
+            while (size-- > 0) {
+                crc = _mm_crc32_u8(crc, static_cast<unsigned char>(*data++));
+            }
+            return crc;
+        }
+#endif
+
+        // Ядра постоянной длины для fixed_kernel, по одному на реализацию
+        struct Software {
+            template <size_t Size>
+            static void fixed(const char* data, uint8_t* digest) {
+                store_be32(~software(~0u, data, Size), digest);
+            }
+        };
+
+#ifdef BAYAN_HAVE_SSE42_DISPATCH
+        struct Hardware {
+            template <size_t Size>
+            __attribute__((target("sse4.2")))
+            static void fixed(const char* data, uint8_t* digest) {
+                store_be32(~hardware(~0u, data, Size), digest);
+            }
+        };
+#endif
+
+    public:
+        Crc32cHasher() : kernel_(&Crc32cHasher::software) {
+            init_table();
+#ifdef BAYAN_HAVE_SSE42_DISPATCH
+            if (__builtin_cpu_supports("sse4.2")) {
+                kernel_ = &Crc32cHasher::hardware;
+            }
+#endif
+        }
+
+        const char* name() const override { return "crc32c"; }
+        size_t digest_size() const override { return 4; }
+
+        void hash(const char* data, size_t size, uint8_t* digest) const override {
+            store_be32(~kernel_(~0u, data, size), digest);
+        }
+
+        BlockKernel block_kernel(size_t block_size) const override {
+#ifdef BAYAN_HAVE_SSE42_DISPATCH
+            if (kernel_ == &Crc32cHasher::hardware) {
+                return fixed_kernel<Hardware>(block_size);
+            }
+#endif
+            return fixed_kernel<Software>(block_size);
+        }
+    };
+
+    uint32_t Crc32cHasher::table_[8][256];
+
+    // xxHash64 - быстрый 64-битный некриптографический хеш
+    class XxHash64Hasher : public Hasher {
+    private:
+        static const uint64_t prime1 = 11400714785074694791ULL;
+        static const uint64_t prime2 = 14029467366897019727ULL;
+        static const uint64_t prime3 = 1609587929392839161ULL;
+        static const uint64_t prime4 = 9650029242287828579ULL;
+        static const uint64_t prime5 = 2870177450012600261ULL;
+
+        static uint64_t round(uint64_t acc, uint64_t input) {
+            acc += input * prime2;
+            acc = rotl64(acc, 31);
+            return acc * prime1;
+        }
+
+        static uint64_t merge_round(uint64_t acc, uint64_t value) {
+            acc ^= round(0, value);
+            return acc * prime1 + prime4;
+        }
+
+    public:
+        const char* name() const override { return "xxhash64"; }
+        size_t digest_size() const override { return 8; }
+
+        static BAYAN_ALWAYS_INLINE void compute(const char* data, size_t size, uint8_t* digest) {
+            const uint64_t seed = 0;
+            const char* p = data;
+            const char* end = data + size;
+            uint64_t h64;
+
+            if (size >= 32) {
+                // Четыре независимых аккумулятора - компилятор раскладывает их по регистрам
+                uint64_t v1 = seed + prime1 + prime2;
+                uint64_t v2 = seed + prime2;
+                uint64_t v3 = seed;
+                uint64_t v4 = seed - prime1;
+                const char* limit = end - 32;
+                do {
+                    v1 = round(v1, load_le64(p));
+                    v2 = round(v2, load_le64(p + 8));
+                    v3 = round(v3, load_le64(p + 16));
+                    v4 = round(v4, load_le64(p + 24));
+                    p += 32;
+                } while (p <= limit);
+
+                h64 = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+                h64 = merge_round(h64, v1);
+                h64 = merge_round(h64, v2);
+                h64 = merge_round(h64, v3);
+                h64 = merge_round(h64, v4);
+            } else {
+                h64 = seed + prime5;
+            }
+
+            h64 += static_cast<uint64_t>(size);
+
+            while (p + 8 <= end) {
+                h64 ^= round(0, load_le64(p));
+                h64 = rotl64(h64, 27) * prime1 + prime4;
+                p += 8;
+            }
+            if (p + 4 <= end) {
+                h64 ^= static_cast<uint64_t>(load_le32(p)) * prime1;
+                h64 = rotl64(h64, 23) * prime2 + prime3;
+                p += 4;
+            }
+            while (p < end) {
+                h64 ^= static_cast<uint64_t>(static_cast<unsigned char>(*p)) * prime5;
+                h64 = rotl64(h64, 11) * prime1;
+                ++p;
+            }
+
+            h64 ^= h64 >> 33;
+            h64 *= prime2;
+            h64 ^= h64 >> 29;
+            h64 *= prime3;
+            h64 ^= h64 >> 32;
+
+            // Порядок байт как у XXH64_canonicalFromHash (big-endian)
+            for (int i = 0; i < 8; ++i) {
+                digest[i] = static_cast<uint8_t>(h64 >> (56 - 8 * i));
+            }
+        }
+
+        void hash(const char* data, size_t size, uint8_t* digest) const override {
+            compute(data, size, digest);
+        }
+
+        template <size_t Size>
+        static void fixed(const char* data, uint8_t* digest) {
+            compute(data, Size, digest);
+        }
+
+        BlockKernel block_kernel(size_t block_size) const override {
+            return fixed_kernel<XxHash64Hasher>(block_size);
+        }
+
+    };
+
+    // MD5 (RFC 1321)
+    class Md5Hasher : public Hasher {
+    public:
+        const char* name() const override { return "md5"; }
+        size_t digest_size() const override { return 16; }
+
+        static BAYAN_ALWAYS_INLINE void compute(const char* data, size_t size, uint8_t* digest) {
+            static const uint32_t k[64] = {
+                0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+                0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+                0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+                0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+                0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+                0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+                0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+                0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+                0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+                0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+                0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+            static const int shifts[64] = {
+                7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+                5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+                4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+                6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21};
+
+            uint32_t state[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+
+            merkle_damgard(data, size, false, [&](const unsigned char* chunk) {
+                uint32_t m[16];
+                for (int i = 0; i < 16; ++i) {
+                    m[i] = load_le32(reinterpret_cast<const char*>(chunk + 4 * i));
+                }
+                uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+                for (int i = 0; i < 64; ++i) {
+                    uint32_t f;
+                    int g;
+                    if (i < 16) {
+                        f = (b & c) | (~b & d);
+                        g = i;
+                    } else if (i < 32) {
+                        f = (d & b) | (~d & c);
+                        g = (5 * i + 1) % 16;
+                    } else if (i < 48) {
+                        f = b ^ c ^ d;
+                        g = (3 * i + 5) % 16;
+                    } else {
+                        f = c ^ (b | ~d);
+                        g = (7 * i) % 16;
+                    }
+                    uint32_t rotated = rotl32(a + f + k[i] + m[g], shifts[i]);
+                    a = d;
+                    d = c;
+                    c = b;
+                    b += rotated;
+                }
+                state[0] += a;
+                state[1] += b;
+                state[2] += c;
+                state[3] += d;
+            });
+
+            for (int i = 0; i < 4; ++i) {
+                store_le32(state[i], digest + 4 * i);
+            }
+        }
+
+        void hash(const char* data, size_t size, uint8_t* digest) const override {
+            compute(data, size, digest);
+        }
+
+        template <size_t Size>
+        static void fixed(const char* data, uint8_t* digest) {
+            compute(data, Size, digest);
+        }
+
+        BlockKernel block_kernel(size_t block_size) const override {
+            return fixed_kernel<Md5Hasher>(block_size);
+        }
+
+    };
+
+    // SHA-256 (FIPS 180-4) - для тех, кому нужна стойкость к коллизиям
+    class Sha256Hasher : public Hasher {
+    public:
+        const char* name() const override { return "sha256"; }
+        size_t digest_size() const override { return 32; }
+
+        static BAYAN_ALWAYS_INLINE void compute(const char* data, size_t size, uint8_t* digest) {
+            static const uint32_t k[64] = {
+                0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+                0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+                0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+                0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+                0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+                0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+                0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+                0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+                0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+                0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+                0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+            uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+            merkle_damgard(data, size, true, [&](const unsigned char* chunk) {
+                uint32_t w[64];
+                for (int i = 0; i < 16; ++i) {
+                    w[i] = load_be32(chunk + 4 * i);
+                }
+                for (int i = 16; i < 64; ++i) {
+                    uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                    uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+                }
+                uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+                uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+                for (int i = 0; i < 64; ++i) {
+                    uint32_t s1 = rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25);
+                    uint32_t ch = (e & f) ^ (~e & g);
+                    uint32_t temp1 = h + s1 + ch + k[i] + w[i];
+                    uint32_t s0 = rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22);
+                    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+                    uint32_t temp2 = s0 + maj;
+                    h = g;
+                    g = f;
+                    f = e;
+                    e = d + temp1;
+                    d = c;
+                    c = b;
+                    b = a;
+                    a = temp1 + temp2;
+                }
+                state[0] += a;
+                state[1] += b;
+                state[2] += c;
+                state[3] += d;
+                state[4] += e;
+                state[5] += f;
+                state[6] += g;
+                state[7] += h;
+            });
+
+            for (int i = 0; i < 8; ++i) {
+                store_be32(state[i], digest + 4 * i);
+            }
+        }
+
+        void hash(const char* data, size_t size, uint8_t* digest) const override {
+            compute(data, size, digest);
+        }
+
+        template <size_t Size>
+        static void fixed(const char* data, uint8_t* digest) {
+            compute(data, Size, digest);
+        }
+
+        BlockKernel block_kernel(size_t block_size) const override {
+            return fixed_kernel<Sha256Hasher>(block_size);
+        }
+
+    };
+}
+
+std::unique_ptr<Hasher> Hasher::create(const std::string& name) {
+    if (name == "crc32") {
+        return std::make_unique<Crc32Hasher>();
+    }
+    if (name == "crc32c") {
+        return std::make_unique<Crc32cHasher>();
+    }
+    if (name == "xxhash64") {
+        return std::make_unique<XxHash64Hasher>();
+    }
+    if (name == "md5") {
+        return std::make_unique<Md5Hasher>();
+    }
+    if (name == "sha256") {
+        return std::make_unique<Sha256Hasher>();
+    }
+    throw std::invalid_argument("Unknown hash algorithm: " + name);
+}
+
+std::vector<std::string> Hasher::available() {
+    return {"crc32", "crc32c", "xxhash64", "md5", "sha256"};
+}
+
+std::string Hasher::to_hex(const uint8_t* digest, size_t size) {
+    std::stringstream ss;
+    ss << std::hex << std::setfill('0');
+    for (size_t i = 0; i < size; ++i) {
+        ss << std::setw(2) << static_cast<unsigned>(digest[i]);
+    }
+    return ss.str();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Алгоритм хеширования блоков.
+// Реализации не хранят состояния между вызовами и безопасны для потоков.
+class Hasher {
+public:
+    // Наибольший размер хеша среди всех алгоритмов (SHA-256)
+    static const size_t max_digest_size = 32;
+
+    virtual ~Hasher() = default;
+
+    // Имя алгоритма, как оно задаётся в --hash
+    virtual const char* name() const = 0;
+
+    // Размер хеша в байтах
+    virtual size_t digest_size() const = 0;
+
+    // Вычислить хеш data[0..size) и записать digest_size() байт в digest
+    virtual void hash(const char* data, size_t size, uint8_t* digest) const = 0;
+
+    // Хеш блока, длина которого задана при компиляции ядра
+    using BlockKernel = void (*)(const char* data, uint8_t* digest);
+
+    // Ядро, специализированное под блоки ровно block_size байт (степени
+    // двойки от 4 КиБ до 1 МиБ), или nullptr - тогда используется hash().
+    // Результат совпадает с hash(data, block_size, digest).
+    virtual BlockKernel block_kernel(size_t block_size) const {
+        (void)block_size;
+        return nullptr;
+    }
+
+    // Создать алгоритм по имени. Реализация с аппаратным ускорением
+    // выбирается по возможностям процессора. Неизвестное имя - std::invalid_argument.
+    static std::unique_ptr<Hasher> create(const std::string& name);
+
+    // Имена всех алгоритмов для справки
+    static std::vector<std::string> available();
+
+    // Шестнадцатеричное представление хеша - только для показа пользователю
+    static std::string to_hex(const uint8_t* digest, size_t size);
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Известные хеши блоков одного файла: непрерывный префикс блоков 0..n-1
+// и отдельные блоки за ним. Выборка читает последний и внутренние блоки
+// раньше остальных - их хеши хранятся отдельно, пока последовательный
+// проход не дойдёт до них; тогда они переходят в префикс.
+class KnownHashes {
+private:
+    size_t digest_size_;
+    std::vector<uint8_t> prefix_;       // Хеши блоков 0..prefix_count()-1 подряд
+    std::vector<uint64_t> blocks_;      // Номера отдельных блоков по возрастанию
+    std::vector<uint8_t> scattered_;    // Их хеши в том же порядке
+
+    // Перенести в префикс отдельные блоки, ставшие его продолжением
+    void absorb() {
+        size_t moved = 0;
+        while (moved < blocks_.size() && blocks_[moved] == prefix_count()) {
+            const uint8_t* digest = scattered_.data() + moved * digest_size_;
+            prefix_.insert(prefix_.end(), digest, digest + digest_size_);
+            ++moved;
+        }
+        if (moved > 0) {
+            blocks_.erase(blocks_.begin(), blocks_.begin() + static_cast<std::ptrdiff_t>(moved));
+            scattered_.erase(scattered_.begin(),
+                             scattered_.begin() + static_cast<std::ptrdiff_t>(moved * digest_size_));
+        }
+    }
+
+public:
+    explicit KnownHashes(size_t digest_size = 0) : digest_size_(digest_size) {}
+
+    size_t digest_size() const { return digest_size_; }
+    bool empty() const { return prefix_.empty() && blocks_.empty(); }
+    size_t prefix_count() const { return digest_size_ ? prefix_.size() / digest_size_ : 0; }
+    size_t scattered_count() const { return blocks_.size(); }
+    size_t count() const { return prefix_count() + scattered_count(); }
+
+    // Хеш блока block в digest; false, если он неизвестен
+    bool find(size_t block, uint8_t* digest) const {
+        if (block < prefix_count()) {
+            std::memcpy(digest, prefix_.data() + block * digest_size_, digest_size_);
+            return true;
+        }
+        auto it = std::lower_bound(blocks_.begin(), blocks_.end(), block);
+        if (it == blocks_.end() || *it != block) {
+            return false;
+        }
+        size_t index = static_cast<size_t>(it - blocks_.begin());
+        std::memcpy(digest, scattered_.data() + index * digest_size_, digest_size_);
+        return true;
+    }
+
+    // Запомнить хеш блока block (уже известный не заменяется)
+    void add(size_t block, const uint8_t* digest) {
+        if (block < prefix_count()) {
+            return;
+        }
+        if (block == prefix_count()) {
+            prefix_.insert(prefix_.end(), digest, digest + digest_size_);
+            absorb();
+            return;
+        }
+        auto it = std::lower_bound(blocks_.begin(), blocks_.end(), block);
+        if (it != blocks_.end() && *it == block) {
+            return;
+        }
+        size_t index = static_cast<size_t>(it - blocks_.begin());
+        blocks_.insert(it, block);
+        scattered_.insert(scattered_.begin() + static_cast<std::ptrdiff_t>(index * digest_size_),
+                          digest, digest + digest_size_);
+    }
+
+    // Добавить все хеши other (с тем же размером хеша)
+    void merge(const KnownHashes& other) {
+        for (size_t block = 0; block < other.prefix_count(); ++block) {
+            add(block, other.prefix_.data() + block * digest_size_);
+        }
+        for (size_t i = 0; i < other.blocks_.size(); ++i) {
+            add(static_cast<size_t>(other.blocks_[i]), other.scattered_.data() + i * digest_size_);
+        }
+    }
+
+    // Освободить память
+    void clear() {
+        prefix_ = std::vector<uint8_t>();
+        blocks_ = std::vector<uint64_t>();
+        scattered_ = std::vector<uint8_t>();
+    }
+
+    size_t memory() const {
+        return prefix_.capacity() + blocks_.capacity() * sizeof(uint64_t) + scattered_.capacity();
+    }
+
+    // Сырые данные для записи в постоянный кэш и чтения из него
+    std::vector<uint8_t>& prefix() { return prefix_; }
+    std::vector<uint64_t>& blocks() { return blocks_; }
+    std::vector<uint8_t>& scattered() { return scattered_; }
+    const std::vector<uint8_t>& prefix() const { return prefix_; }
+    const std::vector<uint64_t>& blocks() const { return blocks_; }
+    const std::vector<uint8_t>& scattered() const { return scattered_; }
+};
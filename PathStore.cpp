@@ -0,0 +1,123 @@
+#include "PathStore.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+    const char separator = static_cast<char>(boost::filesystem::path::preferred_separator);
+
+    bool is_separator(char c) {
+#ifdef BOOST_WINDOWS_API
+        return c == '/' || c == '\\';
+#else
+        return c == '/';
+#endif
+    }
+
+    // Разделитель меньше любого символа имени: сравнение строк тогда
+    // совпадает с покомпонентным сравнением путей
+    unsigned char order_key(char c) {
+        return is_separator(c) ? 0 : static_cast<unsigned char>(c);
+    }
+}
+
+PathStore::PathStore() : names_(), directories_(), files_(), mutex_() {}
+
+PathStore::Node PathStore::make_node(uint32_t parent, std::string_view name) {
+    Node node;
+    node.name_offset = names_.size();
+    node.name_length = static_cast<uint32_t>(name.size());
+    node.parent = parent;
+    names_.insert(names_.end(), name.begin(), name.end());
+    return node;
+}
+
+uint32_t PathStore::add_root(const std::string& path) {
+    return add_directory(no_parent, path);
+}
+
+uint32_t PathStore::add_directory(uint32_t directory, std::string_view name) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (directories_.size() >= no_parent) {
+        throw std::length_error("Too many directories for 32-bit path identifiers");
+    }
+    directories_.push_back(make_node(directory, name));
+    return static_cast<uint32_t>(directories_.size() - 1);
+}
+
+uint32_t PathStore::add_file(uint32_t directory, std::string_view name) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (files_.size() >= no_parent) {
+        throw std::length_error("Too many files for 32-bit path identifiers");
+    }
+    files_.push_back(make_node(directory, name));
+    return static_cast<uint32_t>(files_.size() - 1);
+}
+
+void PathStore::append_name(const Node& node, std::string& out) const {
+    // Разделитель - только если его ещё нет (корень может заканчиваться на него)
+    if (!out.empty() && !is_separator(out.back())) {
+        out.push_back(separator);
+    }
+    out.append(names_.data() + node.name_offset, node.name_length);
+}
+
+void PathStore::append_directory(uint32_t directory, std::string& out) const {
+    const Node& node = directories_[directory];
+    if (node.parent == no_parent) {
+        out.append(names_.data() + node.name_offset, node.name_length);
+        return;
+    }
+    append_directory(node.parent, out);
+    append_name(node, out);
+}
+
+void PathStore::append_path(uint32_t file, std::string& out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const Node& node = files_[file];
+    append_directory(node.parent, out);
+    append_name(node, out);
+}
+
+boost::filesystem::path PathStore::path(uint32_t file) const {
+    std::string result;
+    append_path(file, result);
+    return boost::filesystem::path(result);
+}
+
+bool PathStore::less(uint32_t file1, uint32_t file2) const {
+    // Буферы переиспользуются: сортировка миллионов файлов без выделений памяти
+    thread_local std::string left;
+    thread_local std::string right;
+    left.clear();
+    right.clear();
+    append_path(file1, left);
+    append_path(file2, right);
+
+    size_t common = std::min(left.size(), right.size());
+    for (size_t i = 0; i < common; ++i) {
+        unsigned char a = order_key(left[i]);
+        unsigned char b = order_key(right[i]);
+        if (a != b) {
+            return a < b;
+        }
+    }
+    return left.size() < right.size();
+}
+
+size_t PathStore::file_count() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return files_.size();
+}
+
+size_t PathStore::directory_count() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return directories_.size();
+}
+
+void PathStore::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    names_ = std::vector<char>();
+    directories_ = std::vector<Node>();
+    files_ = std::vector<Node>();
+}
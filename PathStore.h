@@ -0,0 +1,64 @@
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Компактное хранилище путей найденных файлов.
+// Директории образуют дерево со ссылками на родителя, имена файлов и
+// директорий лежат подряд в одной арене. Файл по конвейеру передаётся
+// 32-битным номером, полный путь собирается только для открытия и вывода.
+// Вместо отдельной строки с повторяющимся префиксом директории на каждый
+// файл приходится запись в 16 байт и его собственное имя.
+//
+// Добавление и чтение безопасны из нескольких потоков. Записи не удаляются
+// по одной: долгоживущий владелец (--watch) очищает хранилище целиком
+// перед полным пересканированием.
+class PathStore {
+private:
+    struct Node {
+        uint64_t name_offset;       // Имя в арене
+        uint32_t name_length;
+        uint32_t parent;            // Родительская директория (no_parent - корень)
+    };
+
+    std::vector<char> names_;       // Арена имён
+    std::vector<Node> directories_;
+    std::vector<Node> files_;
+    mutable std::shared_mutex mutex_;
+
+    Node make_node(uint32_t parent, std::string_view name);
+    void append_directory(uint32_t directory, std::string& out) const;
+    void append_name(const Node& node, std::string& out) const;
+
+public:
+    static const uint32_t no_parent = UINT32_MAX;
+
+    PathStore();
+
+    PathStore(const PathStore&) = delete;
+    PathStore& operator=(const PathStore&) = delete;
+
+    // Корневая директория сканирования (имя - путь целиком, как задан)
+    uint32_t add_root(const std::string& path);
+
+    // Поддиректория и файл внутри директории directory
+    uint32_t add_directory(uint32_t directory, std::string_view name);
+    uint32_t add_file(uint32_t directory, std::string_view name);
+
+    // Полный путь файла
+    boost::filesystem::path path(uint32_t file) const;
+    void append_path(uint32_t file, std::string& out) const;
+
+    // Порядок путей по компонентам, как у boost::filesystem::path::operator<
+    bool less(uint32_t file1, uint32_t file2) const;
+
+    size_t file_count() const;
+    size_t directory_count() const;
+
+    // Удалить все пути; выданные номера становятся недействительными
+    void clear();
+};
@@ -0,0 +1,199 @@
+#include "PatternMatcher.h"
+#include <algorithm>
+
+namespace {
+    const uint8_t node_exact = 1;       // Шаблон заканчивается в этом узле
+    const uint8_t node_prefix = 2;      // Любое продолжение после узла подходит
+
+    // Таблица приведения к нижнему регистру: без вызовов tolower и копий строк
+    struct FoldTable {
+        unsigned char map[256];
+
+        FoldTable() {
+            for (int c = 0; c < 256; ++c) {
+                map[c] = static_cast<unsigned char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+            }
+        }
+    };
+
+    const FoldTable fold_table;
+
+    unsigned char fold(char c) {
+        return fold_table.map[static_cast<unsigned char>(c)];
+    }
+
+    uint64_t edge_key(uint32_t node, unsigned char c) {
+        return (static_cast<uint64_t>(node) << 8) | c;
+    }
+
+    std::string fold_string(const std::string& text) {
+        std::string result(text);
+        for (char& c : result) {
+            c = static_cast<char>(fold(c));
+        }
+        return result;
+    }
+
+    // Часть шаблона совпадает с text начиная с pos ('?' - любой символ)
+    bool part_matches_at(const std::string& part, std::string_view text, size_t pos) {
+        for (size_t i = 0; i < part.size(); ++i) {
+            if (part[i] != '?' && static_cast<unsigned char>(part[i]) != fold(text[pos + i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+PatternMatcher::Trie::Trie() : edges(), flags(1, 0) {}
+
+void PatternMatcher::Trie::insert(std::string_view literal, uint8_t flag, bool reversed) {
+    uint32_t node = 0;
+    for (size_t i = 0; i < literal.size(); ++i) {
+        unsigned char c = fold(reversed ? literal[literal.size() - 1 - i] : literal[i]);
+        auto inserted = edges.emplace(edge_key(node, c), static_cast<uint32_t>(flags.size()));
+        if (inserted.second) {
+            flags.push_back(0);
+        }
+        node = inserted.first->second;
+    }
+    flags[node] |= flag;
+}
+
+bool PatternMatcher::Trie::match(std::string_view text, bool reversed) const {
+    uint32_t node = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (flags[node] & node_prefix) {
+            return true;
+        }
+        unsigned char c = fold(reversed ? text[text.size() - 1 - i] : text[i]);
+        auto found = edges.find(edge_key(node, c));
+        if (found == edges.end()) {
+            return false;
+        }
+        node = found->second;
+    }
+    return (flags[node] & (node_exact | node_prefix)) != 0;
+}
+
+bool PatternMatcher::Glob::match(std::string_view text) const {
+    size_t begin = 0;
+    size_t end = text.size();
+    size_t first = 0;
+    size_t last = parts.size();
+
+    if (anchored_start && !parts.empty()) {
+        const std::string& part = parts.front();
+        if (part.size() > end || !part_matches_at(part, text, 0)) {
+            return false;
+        }
+        begin = part.size();
+        first = 1;
+    }
+    if (anchored_end && last > first) {
+        const std::string& part = parts.back();
+        if (part.size() > end - begin || !part_matches_at(part, text, end - part.size())) {
+            return false;
+        }
+        end -= part.size();
+        --last;
+    } else if (anchored_end && anchored_start && parts.size() == 1) {
+        // Шаблон без звёздочек: длина должна совпасть точно
+        return begin == end;
+    }
+
+    // Средние части - самое левое вхождение по порядку (жадно и без возвратов)
+    for (size_t p = first; p < last; ++p) {
+        const std::string& part = parts[p];
+        bool found = false;
+        while (begin + part.size() <= end) {
+            if (part_matches_at(part, text, begin)) {
+                found = true;
+                break;
+            }
+            ++begin;
+        }
+        if (!found) {
+            return false;
+        }
+        begin += part.size();
+    }
+    return true;
+}
+
+PatternMatcher::PatternMatcher() : match_all_(false), forward_(), backward_(), globs_() {}
+
+PatternMatcher::Glob PatternMatcher::compile_glob(const std::string& pattern) {
+    Glob glob;
+    std::string folded = fold_string(pattern);
+    glob.anchored_start = folded.empty() || folded.front() != '*';
+    glob.anchored_end = folded.empty() || folded.back() != '*';
+    std::string part;
+    for (char c : folded) {
+        if (c == '*') {
+            if (!part.empty()) {
+                glob.parts.push_back(part);
+                part.clear();
+            }
+        } else {
+            part.push_back(c);
+        }
+    }
+    if (!part.empty() || glob.parts.empty()) {
+        glob.parts.push_back(part);
+    }
+    return glob;
+}
+
+PatternMatcher PatternMatcher::masks(const std::vector<std::string>& masks) {
+    PatternMatcher matcher;
+    for (const auto& mask : masks) {
+        if (mask.find_first_not_of('*') == std::string::npos && !mask.empty()) {
+            matcher.match_all_ = true;
+            continue;
+        }
+        size_t stars = static_cast<size_t>(std::count(mask.begin(), mask.end(), '*'));
+        bool has_any = mask.find('?') != std::string::npos;
+        std::string_view text(mask);
+        if (!has_any && stars == 0) {
+            matcher.forward_.insert(text, node_exact, false);
+        } else if (!has_any && stars == 1 && mask.back() == '*') {
+            matcher.forward_.insert(text.substr(0, text.size() - 1), node_prefix, false);
+        } else if (!has_any && stars == 1 && mask.front() == '*') {
+            matcher.backward_.insert(text.substr(1), node_prefix, true);
+        } else {
+            matcher.globs_.push_back(compile_glob(mask));
+        }
+    }
+    return matcher;
+}
+
+PatternMatcher PatternMatcher::prefixes(const std::vector<std::string>& prefixes) {
+    PatternMatcher matcher;
+    for (const auto& prefix : prefixes) {
+        matcher.forward_.insert(prefix, node_prefix, false);
+    }
+    return matcher;
+}
+
+bool PatternMatcher::empty() const {
+    return !match_all_ && forward_.empty() && backward_.empty() && globs_.empty();
+}
+
+bool PatternMatcher::matches(std::string_view text) const {
+    if (match_all_) {
+        return true;
+    }
+    if (!forward_.empty() && forward_.match(text, false)) {
+        return true;
+    }
+    if (!backward_.empty() && backward_.match(text, true)) {
+        return true;
+    }
+    for (const auto& glob : globs_) {
+        if (glob.match(text)) {
+            return true;
+        }
+    }
+    return false;
+}
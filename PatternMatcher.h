@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Набор шаблонов, скомпилированный один раз при создании сканера.
+// Сравнение без учёта регистра (ASCII) и без выделения памяти на каждый файл.
+//
+// Маски имён (masks):
+// - "*" - любое имя;
+// - "name" - точное имя, "prefix*" - начало имени, "*suffix" - конец имени:
+//   литералы хранятся в префиксном дереве (для суффиксов - в перевёрнутом);
+// - остальные шаблоны с * и ? (например "*report*.*") компилируются
+//   в последовательность литеральных частей между звёздочками.
+//
+// Префиксы путей (prefixes) - исключаемые директории: путь совпадает,
+// если начинается с одного из префиксов.
+class PatternMatcher {
+private:
+    // Префиксное дерево: рёбра в одной хеш-таблице (узел, символ) -> узел
+    struct Trie {
+        std::unordered_map<uint64_t, uint32_t> edges;
+        std::vector<uint8_t> flags;                 // Флаги узлов (node_exact, node_prefix)
+
+        Trie();
+        void insert(std::string_view literal, uint8_t flag, bool reversed);
+        bool match(std::string_view text, bool reversed) const;
+        bool empty() const { return flags.size() == 1 && flags[0] == 0; }
+    };
+
+    // Шаблон с * и ?: литеральные части между звёздочками ('?' - любой символ)
+    struct Glob {
+        std::vector<std::string> parts;
+        bool anchored_start;                        // Шаблон не начинается с '*'
+        bool anchored_end;                          // Шаблон не заканчивается на '*'
+
+        bool match(std::string_view text) const;
+    };
+
+    bool match_all_;
+    Trie forward_;                                  // Точные имена, "prefix*", префиксы путей
+    Trie backward_;                                 // "*suffix" (символы с конца)
+    std::vector<Glob> globs_;
+
+    static Glob compile_glob(const std::string& pattern);
+
+public:
+    PatternMatcher();
+
+    static PatternMatcher masks(const std::vector<std::string>& masks);
+    static PatternMatcher prefixes(const std::vector<std::string>& prefixes);
+
+    bool empty() const;
+    bool matches(std::string_view text) const;
+};
@@ -0,0 +1,97 @@
+#include "Pipeline.h"
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <unordered_map>
+#include "BoundedQueue.h"
+#include "Hash.h"
+#include "ScanDir.h"
+#include "ThreadPool.h"
+
+Pipeline::Pipeline(ScannerDirectory& scanner, Hash& hash, size_t readers, size_t queue_capacity)
+    : scanner_(scanner), hash_(hash), readers_(ThreadPool::resolve_thread_count(readers)),
+      queue_capacity_(queue_capacity), files_found_(0) {}
+
+SizeGroups Pipeline::run(const std::vector<std::string>& dirs_to_scan) {
+    BoundedQueue<FileRecord> scanned(queue_capacity_);      // Обход -> индекс размеров
+    BoundedQueue<FileRecord> candidates(queue_capacity_);   // Индекс -> предварительное чтение
+
+    ThreadPool readers(readers_);
+    for (size_t i = 0; i < readers.size(); ++i) {
+        readers.submit([this, &candidates]() {
+            try {
+                FileRecord record;
+                while (candidates.pop(record)) {
+                    hash_.prefetch(record, scanner_.paths());
+                }
+            } catch (...) {
+                candidates.close();  // Индекс не должен ждать места в очереди вечно
+                throw;
+            }
+        });
+    }
+
+    std::exception_ptr scan_error;
+    std::thread walker([this, &dirs_to_scan, &scanned, &scan_error]() {
+        try {
+            scanner_.scan_directories(dirs_to_scan, [&scanned](FileRecord&& record) {
+                scanned.push(std::move(record));
+            });
+        } catch (...) {
+            scan_error = std::current_exception();
+        }
+        scanned.close();
+    });
+
+    // Индекс размеров ведётся в этом потоке: без блокировок. На размер -
+    // только первый файл и счётчик, сами записи лежат в одном плоском массиве.
+    struct SizeClass {
+        uint32_t first;     // Номер первого файла этого размера в files
+        uint32_t count;
+    };
+    std::unordered_map<uintmax_t, SizeClass> by_size;
+    std::vector<FileRecord> files;
+    try {
+        FileRecord record;
+        while (scanned.pop(record)) {
+            auto inserted = by_size.emplace(record.size,
+                                            SizeClass{static_cast<uint32_t>(files.size()), 0});
+            SizeClass& size_class = inserted.first->second;
+            ++size_class.count;
+            if (size_class.count == 2) {
+                candidates.push(files[size_class.first]);
+                candidates.push(record);
+            } else if (size_class.count > 2) {
+                candidates.push(record);
+            }
+            files.push_back(std::move(record));
+        }
+    } catch (...) {
+        scanned.close();
+        candidates.close();
+        walker.join();
+        throw;
+    }
+
+    walker.join();
+    candidates.close();
+    readers.wait();
+    if (scan_error) {
+        std::rethrow_exception(scan_error);
+    }
+
+    files_found_ = files.size();
+    by_size.clear();
+    SizeGroups groups = SizeGroups::build(std::move(files));
+    // Порядок поступления зависит от потоков обхода - упорядочиваем для воспроизводимого вывода
+    if (scanner_.scan_threads() > 1) {
+        const PathStore& paths = scanner_.paths();
+        for (size_t g = 0; g < groups.size(); ++g) {
+            std::sort(groups.group_begin(g), groups.group_end(g),
+                      [&paths](const FileRecord& a, const FileRecord& b) {
+                          return paths.less(a.id, b.id);
+                      });
+        }
+    }
+    return groups;
+}
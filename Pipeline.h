@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "SizeGroups.h"
+
+class ScannerDirectory;
+class Hash;
+
+// Потоковый режим (--pipeline): сканирование, группировка по размеру и
+// чтение файлов идут одновременно.
+//
+// Стадии связаны очередями ограниченной ёмкости:
+//   обход директорий -> индекс размеров -> потоки предварительного чтения.
+// Как только в классе размера набирается второй файл, оба отдаются на
+// чтение начала (Hash::prefetch), следующие файлы того же размера - сразу.
+// Когда читатели не успевают, очереди заполняются и обход приостанавливается.
+// Файлы уникального размера не читаются; индекс хранит на размер только
+// первый файл и счётчик, записи лежат в плоском массиве.
+class Pipeline {
+private:
+    ScannerDirectory& scanner_;
+    Hash& hash_;
+    size_t readers_;
+    size_t queue_capacity_;
+    size_t files_found_;
+
+public:
+    Pipeline(ScannerDirectory& scanner, Hash& hash, size_t readers, size_t queue_capacity = 4096);
+
+    // Обойти директории и вернуть группы файлов одинакового размера
+    // (не меньше двух файлов в группе) в порядке возрастания размера
+    SizeGroups run(const std::vector<std::string>& dirs_to_scan);
+
+    // Число файлов, найденных последним вызовом run()
+    size_t files_found() const { return files_found_; }
+};
@@ -0,0 +1,157 @@
+#include "ReportWriter.h"
+#include <cstdio>
+#include <stdexcept>
+
+namespace {
+    // Буфер сбрасывается в поток, когда превышает этот размер
+    const size_t flush_threshold = 1 << 20;
+}
+
+ReportWriter::ReportWriter(std::ostream& out, OutputFormat format)
+    : out_(out), format_(format), buffer_(), groups_(0), files_(0), reclaimable_(0) {
+    buffer_.reserve(flush_threshold + 4096);
+    if (format_ == OutputFormat::csv) {
+        buffer_ += "group,size,reclaimable,device,inode,path\n";
+    }
+}
+
+ReportWriter::~ReportWriter() {
+    // Без исключений из деструктора: ошибки записи сообщает finish()
+    if (!buffer_.empty()) {
+        out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        out_.flush();
+    }
+}
+
+OutputFormat ReportWriter::parse_format(const std::string& name) {
+    if (name == "text") {
+        return OutputFormat::text;
+    }
+    if (name == "jsonl") {
+        return OutputFormat::jsonl;
+    }
+    if (name == "nul") {
+        return OutputFormat::nul;
+    }
+    if (name == "csv") {
+        return OutputFormat::csv;
+    }
+    throw std::invalid_argument("Unknown output format: " + name);
+}
+
+void ReportWriter::append_json_string(const std::string& value) {
+    buffer_ += '"';
+    for (char c : value) {
+        switch (c) {
+            case '"': buffer_ += "\\\""; break;
+            case '\\': buffer_ += "\\\\"; break;
+            case '\n': buffer_ += "\\n"; break;
+            case '\r': buffer_ += "\\r"; break;
+            case '\t': buffer_ += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+                    buffer_ += escaped;
+                } else {
+                    buffer_ += c;  // Байты имени выводятся как есть (UTF-8 не проверяется)
+                }
+        }
+    }
+    buffer_ += '"';
+}
+
+void ReportWriter::append_csv_field(const std::string& value) {
+    // RFC 4180: поле в кавычках, если содержит разделитель, кавычку или перевод строки
+    if (value.find_first_of(",\"\r\n") == std::string::npos) {
+        buffer_ += value;
+        return;
+    }
+    buffer_ += '"';
+    for (char c : value) {
+        if (c == '"') {
+            buffer_ += '"';
+        }
+        buffer_ += c;
+    }
+    buffer_ += '"';
+}
+
+void ReportWriter::write(const DuplicateGroup& group) {
+    uintmax_t reclaimable = group.reclaimable_bytes();
+    ++groups_;
+    files_ += group.files.size();
+    reclaimable_ += reclaimable;
+
+    switch (format_) {
+        case OutputFormat::text:
+            for (const DuplicateFile& file : group.files) {
+                buffer_ += file.path.string();
+                buffer_ += '\n';
+            }
+            buffer_ += '\n';
+            break;
+
+        case OutputFormat::jsonl:
+            buffer_ += "{\"size\":";
+            buffer_ += std::to_string(group.size);
+            buffer_ += ",\"reclaimable\":";
+            buffer_ += std::to_string(reclaimable);
+            buffer_ += ",\"files\":[";
+            for (size_t i = 0; i < group.files.size(); ++i) {
+                const DuplicateFile& file = group.files[i];
+                buffer_ += i ? ",{\"path\":" : "{\"path\":";
+                append_json_string(file.path.string());
+                buffer_ += ",\"device\":";
+                buffer_ += std::to_string(file.device);
+                buffer_ += ",\"inode\":";
+                buffer_ += std::to_string(file.inode);
+                buffer_ += '}';
+            }
+            buffer_ += "]}\n";
+            break;
+
+        case OutputFormat::nul:
+            for (const DuplicateFile& file : group.files) {
+                buffer_ += file.path.string();
+                buffer_ += '\0';
+            }
+            buffer_ += '\0';
+            break;
+
+        case OutputFormat::csv: {
+            std::string prefix = std::to_string(groups_) + "," + std::to_string(group.size) + "," +
+                                 std::to_string(reclaimable) + ",";
+            for (const DuplicateFile& file : group.files) {
+                buffer_ += prefix;
+                buffer_ += std::to_string(file.device);
+                buffer_ += ',';
+                buffer_ += std::to_string(file.inode);
+                buffer_ += ',';
+                append_csv_field(file.path.string());
+                buffer_ += '\n';
+            }
+            break;
+        }
+    }
+
+    if (buffer_.size() >= flush_threshold) {
+        flush_buffer();
+    }
+}
+
+void ReportWriter::flush_buffer() {
+    out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+    if (!out_) {
+        throw std::runtime_error("Cannot write duplicate report");
+    }
+}
+
+void ReportWriter::finish() {
+    flush_buffer();
+    out_.flush();
+    if (!out_) {
+        throw std::runtime_error("Cannot write duplicate report");
+    }
+}
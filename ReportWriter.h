@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "DuplicateGroup.h"
+
+// Формат вывода групп дубликатов (--format)
+enum class OutputFormat {
+    text,       // Пути по одному на строку, группы разделены пустой строкой
+    jsonl,      // Группа - один JSON-объект на строке: размер, освобождаемые байты, файлы
+    nul,        // Пути, завершённые '\0'; группа завершается ещё одним '\0' (для xargs -0)
+    csv         // Строка на файл: группа, размер, освобождаемые байты, устройство, inode, путь
+};
+
+// Потоковая запись групп дубликатов: каждая группа выводится сразу,
+// данные копятся в буфере и уходят в поток крупными блоками без сброса
+// на каждой строке
+class ReportWriter {
+private:
+    std::ostream& out_;
+    OutputFormat format_;
+    std::string buffer_;
+    size_t groups_;
+    size_t files_;
+    uintmax_t reclaimable_;
+
+    void append_json_string(const std::string& value);
+    void append_csv_field(const std::string& value);
+    void flush_buffer();
+
+public:
+    ReportWriter(std::ostream& out, OutputFormat format);
+    ~ReportWriter();
+
+    ReportWriter(const ReportWriter&) = delete;
+    ReportWriter& operator=(const ReportWriter&) = delete;
+
+    // Разобрать значение --format; неизвестное значение - std::invalid_argument
+    static OutputFormat parse_format(const std::string& name);
+
+    void write(const DuplicateGroup& group);
+
+    // Дописать буфер; ошибка записи - std::runtime_error
+    void finish();
+
+    // Итоги по записанным группам
+    size_t groups() const { return groups_; }
+    size_t files() const { return files_; }
+    uintmax_t reclaimable_bytes() const { return reclaimable_; }
+};
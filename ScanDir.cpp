@@ -3,183 +3,266 @@
 #include <string>
 #include <boost/filesystem.hpp>
 #include <algorithm>
-#include <cctype>
 #include <functional>
 #include <iostream>
+#include <sstream>
+#include <iterator>
+#include "ThreadPool.h"
+#include "Stats.h"
+
+namespace {
+    // Имя файла - представление хвоста пути без копирования (в отличие от filename())
+    std::string_view file_name_of(const std::string& path) {
+#ifdef BOOST_WINDOWS_API
+        size_t separator = path.find_last_of("/\\");
+#else
+        size_t separator = path.rfind('/');
+#endif
+        std::string_view name(path);
+        if (separator != std::string::npos) {
+            name.remove_prefix(separator + 1);
+        }
+        return name;
+    }
+}
 
 ScannerDirectory::ScannerDirectory(int max_level_scan,
                 size_t min_file_size,
                 const std::vector<std::string>& masks,
-                const std::vector<std::string>& exclude_dirs):
+                const std::vector<std::string>& exclude_dirs,
+                size_t scan_threads,
+                Stats* stats):
                     max_level_scan(max_level_scan),
                     min_file_size_(min_file_size),
-                    masks_(masks),
-                    exclude_dirs_(exclude_dirs) {}
-
-bool ScannerDirectory::is_excluded(const boost::filesystem::path& path) {
-    std::string string_path = path.string();
-    for(const auto& excluded_dir: exclude_dirs_) {
-        std::string excluded_lower = excluded_dir;
-        std::transform(excluded_lower.begin(), excluded_lower.end(),
-                      excluded_lower.begin(), ::tolower);
-        
-        std::string path_lower = string_path;
-        std::transform(path_lower.begin(), path_lower.end(),
-                      path_lower.begin(), ::tolower);
-        
-        if (path_lower.find(excluded_lower) == 0) {
-            return true;
-        }
+                    masks_(PatternMatcher::masks(masks)),
+                    exclude_dirs_(PatternMatcher::prefixes(exclude_dirs)),
+                    scan_threads_(ThreadPool::resolve_thread_count(scan_threads)),
+                    stats_(stats) {
+    if (stats_) {
+        // Процессорное время на каждый stat замерять дороже самого вызова
+        stats_->set_cpu_unmeasured(Phase::stat);
     }
-    return false;
 }
 
-bool ScannerDirectory::matches_mask(const std::string& filename) {
-    if (masks_.empty()) {
-        return true;
-    }
+bool ScannerDirectory::is_excluded(const boost::filesystem::path& path) const {
+    // На POSIX string() возвращает ссылку на хранимую строку - без копии
+    const std::string& string_path = path.string();
+    return exclude_dirs_.matches(string_path);
+}
 
-    std::string filename_lower = filename;
-    std::transform(filename_lower.begin(), filename_lower.end(),
-                   filename_lower.begin(), ::tolower);
+bool ScannerDirectory::matches_mask(std::string_view filename) const {
+    return masks_.empty() || masks_.matches(filename);
+}
 
-    for (const auto& mask : masks_) {
-        std::string mask_lower = mask;
-        std::transform(mask_lower.begin(), mask_lower.end(),
-                       mask_lower.begin(), ::tolower);
+bool ScannerDirectory::is_scannable_root(const boost::filesystem::path& dir_path) {
+    try {
+        return boost::filesystem::exists(dir_path) &&
+               boost::filesystem::is_directory(dir_path) &&
+               !is_excluded(dir_path);
+    } catch (const boost::filesystem::filesystem_error&) {
+        return false;
+    }
+}
 
-        if (mask_lower == "*") {
-            return true;
-        }
+void ScannerDirectory::scan_entries(
+    const boost::filesystem::path& current_dir, uint32_t dir_id, int depth,
+    const FileSink& on_file, const SubdirSink& on_subdir) {
 
-        if (mask_lower.size() > 0 && mask_lower[0] == '*') {
-            std::string extension = mask_lower.substr(1);
-            
-            if (filename_lower.size() >= extension.size()) {
-                std::string file_ending = filename_lower.substr(
-                    filename_lower.size() - extension.size()
-                );
-                
-                if (file_ending == extension) {
-                    return true;
+    if (stats_) {
+        stats_->add_call(Phase::scan);
+    }
+    try {
+        for (const auto& entry : boost::filesystem::directory_iterator(current_dir)) {
+            try {
+                if (boost::filesystem::is_directory(entry.status())) {
+                    // Глубже уровня сканирования директории не нужны даже в хранилище путей
+                    if (accepts_directory(entry.path(), depth + 1)) {
+                        uint32_t subdir_id = paths_.add_directory(
+                            dir_id, file_name_of(entry.path().string()));
+                        on_subdir(entry.path(), subdir_id);
+                    }
                 }
-            }
-        }
-        else if (mask_lower.size() > 0 && mask_lower[mask_lower.size() - 1] == '*') {
-            std::string prefix = mask_lower.substr(0, mask_lower.size() - 1);
-            
-            if (filename_lower.size() >= prefix.size()) {
-                std::string file_prefix = filename_lower.substr(0, prefix.size());
-                
-                if (file_prefix == prefix) {
-                    return true;
+                else if (boost::filesystem::is_regular_file(entry.status())) {
+                    // Маска проверяется до обращения к файлу - stat только для подходящих
+                    const std::string& full_path = entry.path().string();
+                    std::string_view name = file_name_of(full_path);
+                    if (!matches_mask(name)) {
+                        continue;
+                    }
+                    FileRecord record;
+                    uint64_t stat_started = stats_ ? Stats::now_ns() : 0;
+                    bool stat_ok = record.stat(entry.path());
+                    if (stats_) {
+                        stats_->add_call(Phase::stat);
+                        stats_->add_time(Phase::stat, Stats::now_ns() - stat_started);
+                    }
+                    if (!stat_ok) {
+                        // Пропускаем файлы с ошибками доступа к размеру
+                        continue;
+                    }
+                    if (record.size >= min_file_size_) {
+                        // В хранилище попадают только файлы, прошедшие фильтры
+                        record.id = paths_.add_file(dir_id, name);
+                        on_file(std::move(record));
+                    }
                 }
+            } catch (const boost::filesystem::filesystem_error&) {
+                continue;
             }
         }
-        else if (filename_lower == mask_lower) {
-            return true;
-        }
+    } catch (const boost::filesystem::filesystem_error& e) {
+        // Одна запись целиком, чтобы сообщения потоков не перемешивались
+        std::ostringstream message;
+        message << "Warning: Cannot access " << current_dir << ": " << e.what() << "\n";
+        std::cerr << message.str() << std::flush;
     }
+}
 
-    return false;
+bool ScannerDirectory::accepts_directory(const boost::filesystem::path& dir_path, int depth) const {
+    return (max_level_scan < 0 || depth <= max_level_scan) && !is_excluded(dir_path);
 }
 
-std::vector<boost::filesystem::path> ScannerDirectory::scan_single_directory(
-    const boost::filesystem::path& dir_path) {
-    
-    std::vector<boost::filesystem::path> found_files;
-    
-    if (!boost::filesystem::exists(dir_path) || 
-        !boost::filesystem::is_directory(dir_path) ||
-        is_excluded(dir_path)) {
-        return found_files;
-    }
+bool ScannerDirectory::accepts_file(std::string_view name, uintmax_t size) const {
+    return size >= min_file_size_ && matches_mask(name);
+}
 
-    std::function<void(const boost::filesystem::path&, int)> scan_recursive;
+void ScannerDirectory::scan_subtree(const boost::filesystem::path& dir_path, uint32_t dir_id,
+                                    int depth, const FileSink& on_file) {
+    std::function<void(const boost::filesystem::path&, uint32_t, int)> scan_recursive;
     
-    scan_recursive = [&](const boost::filesystem::path& current_dir, int current_depth) {
+    scan_recursive = [&](const boost::filesystem::path& current_dir, uint32_t current_id,
+                         int current_depth) {
         if (max_level_scan >= 0 && current_depth > max_level_scan) {
             return;
         }
-
-        try {
-            for (const auto& entry : boost::filesystem::directory_iterator(current_dir)) {
-                try {
-                    if (boost::filesystem::is_directory(entry.status())) {
-                        if (!is_excluded(entry.path())) {
-                            scan_recursive(entry.path(), current_depth + 1);
-                        }
-                    }
-                    else if (boost::filesystem::is_regular_file(entry.status())) {
-                        try {
-                            auto file_size = boost::filesystem::file_size(entry.path());
-                            if (file_size >= min_file_size_) {
-                                std::string filename = entry.path().filename().string();
-                                if (matches_mask(filename)) {
-                                    found_files.push_back(entry.path());
-                                }
-                            }
-                        } catch (const boost::filesystem::filesystem_error&) {
-                            // Пропускаем файлы с ошибками доступа к размеру
-                            continue;
-                        }
-                    }
-                } catch (const boost::filesystem::filesystem_error&) {
-                    continue;
-                }
-            }
-        } catch (const boost::filesystem::filesystem_error& e) {
-            std::cerr << "Warning: Cannot access " << current_dir << ": " << e.what() << std::endl;
+        if (on_directory_) {
+            on_directory_(current_dir, current_id, current_depth);
         }
+
+        scan_entries(current_dir, current_id, current_depth, on_file,
+                     [&](const boost::filesystem::path& subdir, uint32_t subdir_id) {
+            scan_recursive(subdir, subdir_id, current_depth + 1);
+        });
     };
 
-    scan_recursive(dir_path, 0);
+    scan_recursive(dir_path, dir_id, depth);
+}
+
+void ScannerDirectory::walk_single_directory(const boost::filesystem::path& dir_path,
+                                             const FileSink& on_file) {
+    if (!is_scannable_root(dir_path)) {
+        return;
+    }
+    scan_subtree(dir_path, paths_.add_root(dir_path.string()), 0, on_file);
+}
+
+std::vector<FileRecord> ScannerDirectory::scan_single_directory(
+    const boost::filesystem::path& dir_path) {
+    
+    if (scan_threads_ > 1) {
+        return scan_roots_parallel({dir_path});
+    }
+
+    std::vector<FileRecord> found_files;
+    walk_single_directory(dir_path, [&found_files](FileRecord&& record) {
+        found_files.push_back(std::move(record));
+    });
     return found_files;
 }
 
-std::vector<boost::filesystem::path> ScannerDirectory::scan_directories(
+void ScannerDirectory::scan_parallel(
+    ThreadPool& pool,
+    const FileSink& on_file,
+    const boost::filesystem::path& current_dir, uint32_t dir_id, int current_depth) {
+
+    if (on_directory_) {
+        on_directory_(current_dir, dir_id, current_depth);
+    }
+    scan_entries(current_dir, dir_id, current_depth, on_file,
+                 [&](const boost::filesystem::path& subdir, uint32_t subdir_id) {
+        pool.submit([this, &pool, &on_file, subdir, subdir_id, current_depth]() {
+            scan_parallel(pool, on_file, subdir, subdir_id, current_depth + 1);
+        });
+    });
+}
+
+void ScannerDirectory::walk_roots_parallel(ThreadPool& pool,
+                                           const std::vector<boost::filesystem::path>& roots,
+                                           const FileSink& on_file) {
+    for (const auto& root : roots) {
+        if (!is_scannable_root(root)) {
+            continue;
+        }
+        uint32_t root_id = paths_.add_root(root.string());
+        pool.submit([this, &pool, &on_file, root, root_id]() {
+            scan_parallel(pool, on_file, root, root_id, 0);
+        });
+    }
+    pool.wait();
+}
+
+std::vector<FileRecord> ScannerDirectory::scan_roots_parallel(
+    const std::vector<boost::filesystem::path>& roots) {
+
+    // Файлы собираются в вектор своего потока - без общей блокировки
+    ThreadPool pool(scan_threads_);
+    std::vector<std::vector<FileRecord>> per_worker(pool.size());
+    walk_roots_parallel(pool, roots, [&pool, &per_worker](FileRecord&& record) {
+        per_worker[pool.current_worker()].push_back(std::move(record));
+    });
+
+    size_t total = 0;
+    for (const auto& files : per_worker) {
+        total += files.size();
+    }
+
+    std::vector<FileRecord> all_files;
+    all_files.reserve(total);
+    for (auto& files : per_worker) {
+        std::move(files.begin(), files.end(), std::back_inserter(all_files));
+    }
+
+    // Порядок обхода потоками случаен - сортируем для воспроизводимого вывода
+    std::sort(all_files.begin(), all_files.end(), [this](const FileRecord& a, const FileRecord& b) {
+        return paths_.less(a.id, b.id);
+    });
+    return all_files;
+}
+
+std::vector<FileRecord> ScannerDirectory::scan_directories(
     const std::vector<std::string>& dirs_to_scan) {
     
-    std::vector<boost::filesystem::path> all_files;
+    if (scan_threads_ > 1) {
+        // Все корни обходятся одновременно в общем пуле
+        std::vector<boost::filesystem::path> roots(dirs_to_scan.begin(), dirs_to_scan.end());
+        return scan_roots_parallel(roots);
+    }
+
+    std::vector<FileRecord> all_files;
     
     for (const auto& dir_str : dirs_to_scan) {
         boost::filesystem::path dir_path(dir_str);
         auto files = scan_single_directory(dir_path);
-        all_files.insert(all_files.end(), files.begin(), files.end());
+        all_files.insert(all_files.end(), std::make_move_iterator(files.begin()),
+                         std::make_move_iterator(files.end()));
     }
     
     return all_files;
 }
 
-std::unordered_map<uintmax_t, std::vector<boost::filesystem::path>> 
-ScannerDirectory::group_files_by_size(const std::vector<boost::filesystem::path>& files) {
-    
-    std::unordered_map<uintmax_t, std::vector<boost::filesystem::path>> size_map;
-    
-    for (const auto &file : files) {
-        try {
-            if (boost::filesystem::exists(file) && boost::filesystem::is_regular_file(file)) {
-                uintmax_t size = boost::filesystem::file_size(file);
-                size_map[size].push_back(file);
-            }
-        } catch (const boost::filesystem::filesystem_error&) {
-            continue;
-        }
+void ScannerDirectory::scan_directories(const std::vector<std::string>& dirs_to_scan,
+                                        const FileSink& on_file) {
+    if (scan_threads_ > 1) {
+        std::vector<boost::filesystem::path> roots(dirs_to_scan.begin(), dirs_to_scan.end());
+        ThreadPool pool(scan_threads_);
+        walk_roots_parallel(pool, roots, on_file);
+        return;
+    }
+    for (const auto& dir_str : dirs_to_scan) {
+        walk_single_directory(boost::filesystem::path(dir_str), on_file);
     }
-    return size_map;
 }
 
-std::vector<std::vector<boost::filesystem::path>> 
-ScannerDirectory::get_duplicate_groups_by_size(const std::vector<boost::filesystem::path>& files) {
-    
-    auto size_map = group_files_by_size(files);
-    std::vector<std::vector<boost::filesystem::path>> result;
-    
-    for (const auto &pair : size_map) {
-        if (pair.second.size() > 1) {
-            result.push_back(pair.second);
-        }
-    }
-    
-    return result;
-}
\ No newline at end of file
+SizeGroups ScannerDirectory::get_duplicate_groups_by_size(std::vector<FileRecord> files) {
+    return SizeGroups::build(std::move(files));
+}
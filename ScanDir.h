@@ -3,35 +3,109 @@
 #include <vector>
 #include <string>
 #include <boost/filesystem.hpp>
-#include <unordered_map>
+#include <functional>
+#include "FileRecord.h"
+#include "PatternMatcher.h"
+#include "PathStore.h"
+#include "SizeGroups.h"
+
+class ThreadPool;
+class Stats;
 
 class ScannerDirectory {
+public:
+    // Получатель найденных файлов; при параллельном сканировании
+    // вызывается из нескольких потоков одновременно
+    using FileSink = std::function<void(FileRecord&&)>;
+
+    // Получатель директорий, которые сейчас будут просмотрены: путь, номер
+    // в paths() и глубина от корня. Вызывается до чтения содержимого.
+    using DirectorySink = std::function<void(const boost::filesystem::path&, uint32_t, int)>;
+
 private:
     int max_level_scan;
     size_t min_file_size_;
-    std::vector<std::string> masks_;
-    std::vector<std::string> exclude_dirs_;
+    PatternMatcher masks_;              // Маски имён, скомпилированные при создании
+    PatternMatcher exclude_dirs_;       // Префиксы исключаемых путей
+    size_t scan_threads_;
+    PathStore paths_;                   // Пути всех найденных файлов
+    Stats* stats_;                      // Счётчики --stats (может отсутствовать)
+    DirectorySink on_directory_;        // Наблюдатель директорий (режим --watch)
+
+    // Поддиректория, найденная при обходе: путь для чтения и номер в paths_
+    using SubdirSink = std::function<void(const boost::filesystem::path&, uint32_t)>;
+
+    bool is_excluded(const boost::filesystem::path& path) const;
+    bool matches_mask(std::string_view filename) const;
+
+    // Проверка корневой директории перед обходом
+    bool is_scannable_root(const boost::filesystem::path& dir_path);
+
+    // Просмотр одной директории на глубине depth без рекурсии: подходящие
+    // файлы передаются в on_file, для поддиректорий, которые будут обойдены
+    // (не исключены и не глубже уровня сканирования), вызывается on_subdir
+    void scan_entries(const boost::filesystem::path& current_dir, uint32_t dir_id, int depth,
+                      const FileSink& on_file, const SubdirSink& on_subdir);
+
+    // Последовательный обход одной корневой директории
+    void walk_single_directory(const boost::filesystem::path& dir_path, const FileSink& on_file);
+
+    // Параллельный обход: поддиректории ставятся в очередь пула,
+    // файлы передаются в on_file из потоков пула
+    void scan_parallel(ThreadPool& pool, const FileSink& on_file,
+                       const boost::filesystem::path& current_dir, uint32_t dir_id,
+                       int current_depth);
 
-    bool is_excluded(const boost::filesystem::path& path);
-    bool matches_mask(const std::string& filename);
+    // Параллельный обход набора корневых директорий в общем пуле
+    void walk_roots_parallel(ThreadPool& pool, const std::vector<boost::filesystem::path>& roots,
+                             const FileSink& on_file);
+
+    // Параллельное сканирование набора корневых директорий
+    std::vector<FileRecord> scan_roots_parallel(
+        const std::vector<boost::filesystem::path>& roots);
 
 public:
     ScannerDirectory(int max_level_scan,
                     size_t min_file_size,
                     const std::vector<std::string>& masks,
-                    const std::vector<std::string>& exclude_dirs);
+                    const std::vector<std::string>& exclude_dirs,
+                    size_t scan_threads = 1,
+                    Stats* stats = nullptr);
 
     // Сканирование одной директории
-    std::vector<boost::filesystem::path> scan_single_directory(const boost::filesystem::path& dir_path);
+    std::vector<FileRecord> scan_single_directory(const boost::filesystem::path& dir_path);
     
     // Сканирование нескольких директорий
-    std::vector<boost::filesystem::path> scan_directories(const std::vector<std::string>& dirs_to_scan);
-    
-    // Группировка файлов по размеру
-    std::unordered_map<uintmax_t, std::vector<boost::filesystem::path>> 
-    group_files_by_size(const std::vector<boost::filesystem::path>& files);
+    std::vector<FileRecord> scan_directories(const std::vector<std::string>& dirs_to_scan);
+
+    // Потоковое сканирование: файлы передаются в on_file по мере обхода,
+    // без накопления общего списка
+    void scan_directories(const std::vector<std::string>& dirs_to_scan, const FileSink& on_file);
+
+    // Число потоков обхода
+    size_t scan_threads() const { return scan_threads_; }
+
+    // Пути найденных файлов (по FileRecord::id)
+    const PathStore& paths() const { return paths_; }
+
+    // Хранилище для файлов и директорий, появившихся после сканирования (--watch)
+    PathStore& paths() { return paths_; }
+
+    // Сообщать о каждой просматриваемой директории (при параллельном
+    // сканировании - из потоков пула)
+    void set_directory_sink(DirectorySink on_directory) { on_directory_ = std::move(on_directory); }
+
+    // Последовательно обойти поддерево: директория уже добавлена в paths()
+    // под номером dir_id и лежит на глубине depth (корень - 0)
+    void scan_subtree(const boost::filesystem::path& dir_path, uint32_t dir_id, int depth,
+                      const FileSink& on_file);
+
+    // Фильтры сканирования для отдельного пути: директория на глубине depth
+    // обходится; файл с именем name и размером size попадает в результат
+    bool accepts_directory(const boost::filesystem::path& dir_path, int depth) const;
+    bool accepts_file(std::string_view name, uintmax_t size) const;
     
-    // Получение групп потенциальных дубликатов (одинаковый размер)
-    std::vector<std::vector<boost::filesystem::path>> 
-    get_duplicate_groups_by_size(const std::vector<boost::filesystem::path>& files);
+    // Получение групп потенциальных дубликатов (одинаковый размер);
+    // размер уже получен при сканировании
+    SizeGroups get_duplicate_groups_by_size(std::vector<FileRecord> files);
 };
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "SizeGroups.h"
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+    // Плоская запись для сортировки: 16 байт вместо FileRecord целиком
+    struct SizeKey {
+        uint64_t size;
+        uint32_t index;     // Номер файла во входном массиве
+    };
+
+    // Устойчивая LSD-сортировка по байтам размера. Проходы, в которых у всех
+    // ключей одинаковый байт (обычно старшие байты размера нулевые), пропускаются.
+    void radix_sort(std::vector<SizeKey>& keys) {
+        std::vector<SizeKey> buffer(keys.size());
+        for (unsigned shift = 0; shift < 64; shift += 8) {
+            std::array<size_t, 256> counts{};
+            for (const SizeKey& key : keys) {
+                ++counts[(key.size >> shift) & 0xff];
+            }
+            if (counts[(keys.front().size >> shift) & 0xff] == keys.size()) {
+                continue;
+            }
+            size_t offset = 0;
+            for (size_t& count : counts) {
+                size_t next = offset + count;
+                count = offset;
+                offset = next;
+            }
+            for (const SizeKey& key : keys) {
+                buffer[counts[(key.size >> shift) & 0xff]++] = key;
+            }
+            keys.swap(buffer);
+        }
+    }
+}
+
+SizeGroups::SizeGroups() : files_(), starts_() {}
+
+SizeGroups SizeGroups::build(std::vector<FileRecord> files) {
+    SizeGroups groups;
+    if (files.size() < 2) {
+        return groups;
+    }
+    if (files.size() > UINT32_MAX) {
+        throw std::length_error("Too many files for 32-bit file identifiers");
+    }
+
+    std::vector<SizeKey> keys(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        keys[i].size = static_cast<uint64_t>(files[i].size);
+        keys[i].index = static_cast<uint32_t>(i);
+    }
+    radix_sort(keys);
+
+    // Один проход: отрезки одинакового размера - группы, одиночки отбрасываются
+    size_t grouped = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        bool same_as_prev = i > 0 && keys[i - 1].size == keys[i].size;
+        bool same_as_next = i + 1 < keys.size() && keys[i + 1].size == keys[i].size;
+        grouped += (same_as_prev || same_as_next) ? 1 : 0;
+    }
+    groups.files_.reserve(grouped);
+    for (size_t begin = 0; begin < keys.size();) {
+        size_t end = begin + 1;
+        while (end < keys.size() && keys[end].size == keys[begin].size) {
+            ++end;
+        }
+        if (end - begin > 1) {
+            groups.starts_.push_back(groups.files_.size());
+            for (size_t i = begin; i < end; ++i) {
+                groups.files_.push_back(std::move(files[keys[i].index]));
+            }
+        }
+        begin = end;
+    }
+    if (!groups.files_.empty()) {
+        groups.starts_.push_back(groups.files_.size());
+    }
+    return groups;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "FileRecord.h"
+
+// Группы файлов одинакового размера (не меньше двух файлов в группе).
+// Файлы всех групп лежат подряд в одном массиве, группа - непрерывный
+// отрезок: ни отдельного вектора на каждый размер, ни копирования групп.
+class SizeGroups {
+public:
+    // Отрезок массива файлов - одна группа
+    class Span {
+    private:
+        const FileRecord* first_;
+        size_t count_;
+
+    public:
+        Span(const FileRecord* first, size_t count) : first_(first), count_(count) {}
+
+        size_t size() const { return count_; }
+        const FileRecord& operator[](size_t index) const { return first_[index]; }
+        const FileRecord* begin() const { return first_; }
+        const FileRecord* end() const { return first_ + count_; }
+    };
+
+private:
+    std::vector<FileRecord> files_;     // Файлы групп, группа за группой
+    std::vector<size_t> starts_;        // Начало каждой группы в files_ и files_.size() в конце
+
+public:
+    SizeGroups();
+
+    // Сгруппировать файлы по размеру: устойчивая поразрядная сортировка
+    // плоского массива пар (размер, номер файла), затем один проход,
+    // в котором отрезки одинакового размера становятся группами, а файлы
+    // уникального размера отбрасываются. Группы - по возрастанию размера,
+    // внутри группы сохраняется исходный порядок файлов.
+    static SizeGroups build(std::vector<FileRecord> files);
+
+    size_t size() const { return starts_.empty() ? 0 : starts_.size() - 1; }
+    bool empty() const { return size() == 0; }
+
+    Span operator[](size_t group) const {
+        return Span(files_.data() + starts_[group], starts_[group + 1] - starts_[group]);
+    }
+
+    // Изменяемый доступ к отрезку группы (например, для сортировки по пути)
+    FileRecord* group_begin(size_t group) { return files_.data() + starts_[group]; }
+    FileRecord* group_end(size_t group) { return files_.data() + starts_[group + 1]; }
+};
@@ -0,0 +1,227 @@
+#include "Stats.h"
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BAYAN_POSIX_CLOCKS 1
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+namespace {
+    const char* const phase_names[] = {"scan", "stat", "grouping", "hashing", "comparison"};
+
+    // Больше номеров блоков в таблице не выводим (в JSON - все)
+    const size_t printed_rejections = 16;
+
+    double seconds(uint64_t ns) {
+        return static_cast<double>(ns) / 1e9;
+    }
+
+    double megabytes(uint64_t bytes) {
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    }
+}
+
+Stats::Stats()
+    : phases_(), rejected_mutex_(), rejected_(), started_wall_(now_ns()),
+      started_cpu_(process_cpu_ns()), total_wall_(0), total_cpu_(0), total_peak_rss_(0) {}
+
+Stats::PhaseCounters& Stats::counters(Phase phase) {
+    return phases_[static_cast<size_t>(phase)];
+}
+
+Stats::Scope::Scope(Stats* stats, Phase phase)
+    : stats_(stats), phase_(phase), wall_(0), cpu_(0) {
+    if (stats_) {
+        wall_ = now_ns();
+        cpu_ = process_cpu_ns();
+    }
+}
+
+Stats::Scope::~Scope() {
+    if (stats_) {
+        PhaseCounters& counters = stats_->counters(phase_);
+        counters.wall_ns += now_ns() - wall_;
+        counters.cpu_ns += process_cpu_ns() - cpu_;
+        stats_->mark_peak_rss(phase_);
+    }
+}
+
+Stats::Stopwatch::Stopwatch(PhaseTally* tally) : tally_(tally), wall_(0), cpu_(0) {
+    if (tally_) {
+        wall_ = now_ns();
+        cpu_ = thread_cpu_ns();
+    }
+}
+
+Stats::Stopwatch::~Stopwatch() {
+    if (tally_) {
+        tally_->wall_ns += now_ns() - wall_;
+        tally_->cpu_ns += thread_cpu_ns() - cpu_;
+    }
+}
+
+void Stats::add_call(Phase phase, uint64_t bytes) {
+    PhaseCounters& counters = this->counters(phase);
+    counters.calls.fetch_add(1, std::memory_order_relaxed);
+    if (bytes) {
+        counters.bytes_read.fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+void Stats::add_bytes(Phase phase, uint64_t bytes) {
+    counters(phase).bytes_read.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void Stats::add_time(Phase phase, uint64_t wall_ns) {
+    counters(phase).wall_ns.fetch_add(wall_ns, std::memory_order_relaxed);
+}
+
+void Stats::add_tally(Phase phase, const PhaseTally& tally) {
+    PhaseCounters& counters = this->counters(phase);
+    counters.wall_ns += tally.wall_ns;
+    counters.cpu_ns += tally.cpu_ns;
+    counters.cache_hits += tally.cache_hits;
+    counters.cache_misses += tally.cache_misses;
+}
+
+void Stats::add_rejected(const std::map<size_t, uint64_t>& rejected) {
+    std::lock_guard<std::mutex> lock(rejected_mutex_);
+    for (const auto& entry : rejected) {
+        rejected_[entry.first] += entry.second;
+    }
+}
+
+void Stats::set_cpu_unmeasured(Phase phase) {
+    counters(phase).cpu_measured = false;
+}
+
+void Stats::mark_peak_rss(Phase phase) {
+    counters(phase).peak_rss = peak_rss_bytes();
+}
+
+void Stats::finish() {
+    total_wall_ = now_ns() - started_wall_;
+    total_cpu_ = process_cpu_ns() - started_cpu_;
+    total_peak_rss_ = peak_rss_bytes();
+}
+
+void Stats::print(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    out << "\nStatistics:\n" << std::left << std::setw(12) << "phase" << std::right
+        << std::setw(10) << "wall s" << std::setw(10) << "cpu s" << std::setw(12) << "syscalls"
+        << std::setw(12) << "read MB" << std::setw(12) << "cache hits" << std::setw(12)
+        << "cache miss" << std::setw(14) << "peak RSS MB" << "\n"
+        << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < phase_count; ++i) {
+        const PhaseCounters& phase = phases_[i];
+        out << std::left << std::setw(12) << phase_names[i] << std::right
+            << std::setw(10) << seconds(phase.wall_ns);
+        if (phase.cpu_measured) {
+            out << std::setw(10) << seconds(phase.cpu_ns);
+        } else {
+            out << std::setw(10) << "-";
+        }
+        out << std::setw(12) << phase.calls << std::setw(12) << std::setprecision(1)
+            << megabytes(phase.bytes_read) << std::setw(12) << phase.cache_hits << std::setw(12)
+            << phase.cache_misses << std::setw(14) << megabytes(phase.peak_rss) << "\n"
+            << std::setprecision(3);
+    }
+    out << std::left << std::setw(12) << "total" << std::right << std::setw(10)
+        << seconds(total_wall_) << std::setw(10) << seconds(total_cpu_) << std::setw(62)
+        << std::setprecision(1) << megabytes(total_peak_rss_) << "\n";
+
+    std::lock_guard<std::mutex> lock(rejected_mutex_);
+    if (!rejected_.empty()) {
+        out << "Files rejected at block:";
+        size_t printed = 0;
+        for (const auto& entry : rejected_) {
+            if (printed++ == printed_rejections) {
+                out << " ... (" << rejected_.size() - printed_rejections << " more)";
+                break;
+            }
+            out << " " << entry.first << ":" << entry.second;
+        }
+        out << "\n";
+    }
+    out.flags(flags);
+}
+
+void Stats::write_json(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(6) << "{\n  \"phases\": {\n";
+    for (size_t i = 0; i < phase_count; ++i) {
+        const PhaseCounters& phase = phases_[i];
+        out << "    \"" << phase_names[i] << "\": {\"wall_seconds\": " << seconds(phase.wall_ns)
+            << ", \"cpu_seconds\": ";
+        if (phase.cpu_measured) {
+            out << seconds(phase.cpu_ns);
+        } else {
+            out << "null";
+        }
+        out << ", \"syscalls\": " << phase.calls << ", \"bytes_read\": " << phase.bytes_read
+            << ", \"cache_hits\": " << phase.cache_hits << ", \"cache_misses\": "
+            << phase.cache_misses << ", \"peak_rss_bytes\": " << phase.peak_rss << "}"
+            << (i + 1 < phase_count ? ",\n" : "\n");
+    }
+    out << "  },\n  \"total\": {\"wall_seconds\": " << seconds(total_wall_)
+        << ", \"cpu_seconds\": " << seconds(total_cpu_) << ", \"peak_rss_bytes\": "
+        << total_peak_rss_ << "},\n  \"rejected_by_block\": [";
+
+    std::lock_guard<std::mutex> lock(rejected_mutex_);
+    bool first = true;
+    for (const auto& entry : rejected_) {
+        out << (first ? "" : ", ") << "{\"block\": " << entry.first << ", \"files\": "
+            << entry.second << "}";
+        first = false;
+    }
+    out << "]\n}\n";
+    out.flags(flags);
+}
+
+uint64_t Stats::now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+uint64_t Stats::process_cpu_ns() {
+#ifdef BAYAN_POSIX_CLOCKS
+    struct rusage usage;
+    if (::getrusage(RUSAGE_SELF, &usage) == 0) {
+        auto to_ns = [](const timeval& time) {
+            return static_cast<uint64_t>(time.tv_sec) * 1000000000 +
+                   static_cast<uint64_t>(time.tv_usec) * 1000;
+        };
+        return to_ns(usage.ru_utime) + to_ns(usage.ru_stime);
+    }
+#endif
+    return static_cast<uint64_t>(static_cast<double>(std::clock()) * 1e9 / CLOCKS_PER_SEC);
+}
+
+uint64_t Stats::thread_cpu_ns() {
+#if defined(BAYAN_POSIX_CLOCKS) && defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec time;
+    if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) == 0) {
+        return static_cast<uint64_t>(time.tv_sec) * 1000000000 +
+               static_cast<uint64_t>(time.tv_nsec);
+    }
+#endif
+    // Без часов потока - время процесса: сумма по потокам будет завышена
+    return process_cpu_ns();
+}
+
+uint64_t Stats::peak_rss_bytes() {
+#ifdef BAYAN_POSIX_CLOCKS
+    struct rusage usage;
+    if (::getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        return static_cast<uint64_t>(usage.ru_maxrss);          // macOS - в байтах
+#else
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;   // Linux - в килобайтах
+#endif
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+
+// Этапы работы, по которым собирается статистика (--stats)
+enum class Phase {
+    scan,           // Обход директорий (в режиме --pipeline - вместе с группировкой)
+    stat,           // Вызовы stat для подходящих файлов (внутри обхода)
+    grouping,       // Группировка по размеру
+    hashing,        // Чтение и хеширование блоков
+    comparison      // Разбиение корзин по хешам и отсев уникальных файлов
+};
+
+// Накопитель одного потока: складывается в Stats по окончании работы,
+// чтобы в горячем цикле не было общих атомарных счётчиков
+struct PhaseTally {
+    uint64_t wall_ns = 0;
+    uint64_t cpu_ns = 0;
+    uint64_t cache_hits = 0;
+    uint64_t cache_misses = 0;
+};
+
+// Статистика запуска. Этапы scan и grouping замеряются целиком в основном
+// потоке (процессорное время - всех потоков процесса). Время этапов stat,
+// hashing и comparison - сумма по выполнявшим их потокам.
+// Счётчики потокобезопасны; объект передаётся указателем, nullptr - сбор отключён.
+class Stats {
+private:
+    struct PhaseCounters {
+        std::atomic<uint64_t> wall_ns{0};
+        std::atomic<uint64_t> cpu_ns{0};
+        std::atomic<uint64_t> calls{0};         // Системные вызовы: чтение директорий, stat, чтение файлов
+        std::atomic<uint64_t> bytes_read{0};
+        std::atomic<uint64_t> cache_hits{0};    // Хеши блоков, известные без чтения
+        std::atomic<uint64_t> cache_misses{0};
+        std::atomic<uint64_t> peak_rss{0};      // Пиковый RSS процесса к концу этапа, байт
+        bool cpu_measured = true;
+    };
+
+    static const size_t phase_count = 5;
+    std::array<PhaseCounters, phase_count> phases_;
+
+    mutable std::mutex rejected_mutex_;
+    std::map<size_t, uint64_t> rejected_;       // Номер блока -> файлов отсеяно на нём
+
+    uint64_t started_wall_;
+    uint64_t started_cpu_;
+    uint64_t total_wall_;
+    uint64_t total_cpu_;
+    uint64_t total_peak_rss_;
+
+    PhaseCounters& counters(Phase phase);
+
+public:
+    Stats();
+
+    Stats(const Stats&) = delete;
+    Stats& operator=(const Stats&) = delete;
+
+    // Замер этапа в вызывающем потоке целиком (RAII); при stats == nullptr ничего не делает
+    class Scope {
+    private:
+        Stats* stats_;
+        Phase phase_;
+        uint64_t wall_;
+        uint64_t cpu_;
+
+    public:
+        Scope(Stats* stats, Phase phase);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    // Замер участка внутри потока: время и процессорное время потока
+    // прибавляются к tally; при tally == nullptr ничего не делает
+    class Stopwatch {
+    private:
+        PhaseTally* tally_;
+        uint64_t wall_;
+        uint64_t cpu_;
+
+    public:
+        explicit Stopwatch(PhaseTally* tally);
+        ~Stopwatch();
+
+        Stopwatch(const Stopwatch&) = delete;
+        Stopwatch& operator=(const Stopwatch&) = delete;
+    };
+
+    // Счётчики, обновляемые по ходу работы
+    void add_call(Phase phase, uint64_t bytes = 0);
+    void add_bytes(Phase phase, uint64_t bytes);
+    void add_time(Phase phase, uint64_t wall_ns);
+    void add_tally(Phase phase, const PhaseTally& tally);
+    void add_rejected(const std::map<size_t, uint64_t>& rejected);
+
+    // Время этапа замеряется без процессорного времени (слишком дорого на вызов)
+    void set_cpu_unmeasured(Phase phase);
+
+    // Запомнить пиковый RSS к концу этапа
+    void mark_peak_rss(Phase phase);
+
+    // Зафиксировать общее время работы
+    void finish();
+
+    // Таблица для человека
+    void print(std::ostream& out) const;
+
+    // Тот же набор данных одним JSON-объектом
+    void write_json(std::ostream& out) const;
+
+    static uint64_t now_ns();
+    static uint64_t process_cpu_ns();
+    static uint64_t thread_cpu_ns();
+    static uint64_t peak_rss_bytes();
+};
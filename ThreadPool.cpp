@@ -0,0 +1,143 @@
+#include "ThreadPool.h"
+
+namespace {
+    // Пул и индекс текущего потока (для потоков вне пула - nullptr)
+    thread_local const ThreadPool* current_pool = nullptr;
+    thread_local size_t current_index = 0;
+}
+
+ThreadPool::ThreadPool(size_t threads)
+    : queued_(0), unfinished_(0), next_queue_(0), stop_(false) {
+    if (threads == 0) {
+        threads = 1;
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    size_t target;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (current_pool == this) {
+            target = current_index;
+        } else {
+            target = next_queue_;
+            next_queue_ = (next_queue_ + 1) % queues_.size();
+        }
+        ++unfinished_;
+        ++queued_;
+        // Кладём задачу под mutex_, чтобы счётчик не опережал очередь
+        std::lock_guard<std::mutex> queue_lock(queues_[target]->mutex);
+        queues_[target]->tasks.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::try_pop(size_t index, std::function<void()>& task) {
+    // Своя очередь - с конца (свежие задачи, горячий кэш)
+    {
+        WorkerQueue& own = *queues_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    // Чужие очереди - с начала (самые старые и обычно самые крупные задачи)
+    for (size_t offset = 1; offset < queues_.size(); ++offset) {
+        WorkerQueue& victim = *queues_[(index + offset) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::finish_task(std::exception_ptr error) {
+    bool all_done;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error && !error_) {
+            error_ = error;
+        }
+        all_done = (--unfinished_ == 0);
+    }
+    if (all_done) {
+        done_.notify_all();
+    }
+}
+
+void ThreadPool::worker_loop(size_t index) {
+    current_pool = this;
+    current_index = index;
+
+    for (;;) {
+        std::function<void()> task;
+        if (try_pop(index, task)) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --queued_;
+            }
+            std::exception_ptr error;
+            try {
+                task();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            finish_task(error);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+        if (stop_ && queued_ == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return unfinished_ == 0; });
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+size_t ThreadPool::size() const {
+    return threads_.size();
+}
+
+size_t ThreadPool::current_worker() const {
+    return current_pool == this ? current_index : threads_.size();
+}
+
+size_t ThreadPool::resolve_thread_count(size_t requested) {
+    if (requested > 0) {
+        return requested;
+    }
+    size_t hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
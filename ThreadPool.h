@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков с перехватом работы (work stealing).
+// У каждого потока своя очередь: задачи, порождённые внутри потока пула,
+// кладутся в его очередь, а простаивающие потоки забирают задачи у соседей.
+class ThreadPool {
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;      // Появилась работа или пул останавливается
+    std::condition_variable done_;      // Все задачи выполнены
+    size_t queued_;                     // Задачи в очередях (под mutex_)
+    size_t unfinished_;                 // Поставленные, но не завершённые задачи (под mutex_)
+    size_t next_queue_;                 // Очередь для задач извне пула (под mutex_)
+    bool stop_;
+    std::exception_ptr error_;          // Первое исключение из задач (под mutex_)
+
+    void worker_loop(size_t index);
+    bool try_pop(size_t index, std::function<void()>& task);
+    void finish_task(std::exception_ptr error);
+
+public:
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Поставить задачу в очередь
+    void submit(std::function<void()> task);
+
+    // Дождаться выполнения всех задач, включая порождённые ими.
+    // Пробрасывает первое исключение, выброшенное задачей.
+    void wait();
+
+    size_t size() const;
+
+    // Индекс текущего потока в его пуле или size() для потоков вне пула
+    size_t current_worker() const;
+
+    // Число потоков для значения опции: 0 - по числу ядер
+    static size_t resolve_thread_count(size_t requested);
+};
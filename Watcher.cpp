@@ -0,0 +1,480 @@
+#include "Watcher.h"
+#include "Hash.h"
+#include "ScanDir.h"
+#include "SizeGroups.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    // События, после которых файл проверяется заново. Запись в файл
+    // учитывается при закрытии, а не на каждом write (IN_MODIFY)
+    const uint32_t watch_mask = IN_CREATE | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE |
+                                IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+    // Пауза без событий, после которой изменения применяются без запроса
+    const int quiet_period_ms = 200;
+
+    // Столько изменившихся путей применяются, не дожидаясь паузы
+    const size_t max_dirty_files = 4096;
+
+    volatile std::sig_atomic_t stop_requested = 0;
+
+    void request_stop(int) {
+        stop_requested = 1;
+    }
+
+    sockaddr_un socket_address(const std::string& socket_path) {
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+            throw std::invalid_argument("Invalid socket path: " + socket_path);
+        }
+        std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+        return address;
+    }
+
+    void send_all(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t count = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return;  // Клиент ушёл - отвечать некому
+            }
+            sent += static_cast<size_t>(count);
+        }
+    }
+
+    std::string system_error(const std::string& what) {
+        return what + ": " + std::strerror(errno);
+    }
+}
+
+Watcher::Watcher(ScannerDirectory& scanner, Hash& hash, const std::vector<std::string>& roots,
+                 const std::string& socket_path, OutputFormat default_format)
+    : scanner_(scanner), hash_(hash), roots_(roots), socket_path_(socket_path),
+      default_format_(default_format), inotify_fd_(-1), listen_fd_(-1), directories_mutex_(),
+      directories_(), files_(), sizes_(), groups_(), dirty_files_(), dirty_sizes_() {
+    sockaddr_un address = socket_address(socket_path_);
+
+    // Сокет от прежнего запуска удаляется, от работающего - нет
+    struct stat existing;
+    if (::lstat(socket_path_.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            throw std::runtime_error(socket_path_ + " exists and is not a socket");
+        }
+        int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool alive = probe >= 0 &&
+                     ::connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        if (probe >= 0) {
+            ::close(probe);
+        }
+        if (alive) {
+            throw std::runtime_error("Another watcher is already serving " + socket_path_);
+        }
+        ::unlink(socket_path_.c_str());
+    }
+
+    inotify_fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0) {
+        throw std::runtime_error(system_error("Cannot initialize inotify"));
+    }
+
+    listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0 ||
+        ::bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listen_fd_, 16) != 0) {
+        std::string error = system_error("Cannot listen on " + socket_path_);
+        if (listen_fd_ >= 0) {
+            ::close(listen_fd_);
+        }
+        ::close(inotify_fd_);
+        throw std::runtime_error(error);
+    }
+
+    scanner_.set_directory_sink([this](const boost::filesystem::path& path, uint32_t id, int depth) {
+        watch_directory(path, id, depth);
+    });
+}
+
+Watcher::~Watcher() {
+    scanner_.set_directory_sink(nullptr);
+    ::close(listen_fd_);
+    ::unlink(socket_path_.c_str());
+    ::close(inotify_fd_);
+}
+
+void Watcher::watch_directory(const boost::filesystem::path& path, uint32_t id, int depth) {
+    int wd = ::inotify_add_watch(inotify_fd_, path.c_str(), watch_mask);
+    if (wd < 0) {
+        // Одна запись целиком, чтобы сообщения потоков не перемешивались
+        std::ostringstream message;
+        message << "Warning: Cannot watch " << path << ": " << std::strerror(errno)
+                << (errno == ENOSPC ? " (raise fs.inotify.max_user_watches)" : "") << "\n";
+        std::cerr << message.str() << std::flush;
+        return;
+    }
+    std::lock_guard<std::mutex> lock(directories_mutex_);
+    directories_[wd] = Directory{path, id, depth};
+}
+
+void Watcher::forget_directory(const boost::filesystem::path& path) {
+    const std::string& directory = path.string();
+    std::string prefix = directory + "/";
+    auto inside = [&](const std::string& candidate) {
+        return candidate == directory || candidate.compare(0, prefix.size(), prefix) == 0;
+    };
+
+    // Перемещённая директория остаётся под наблюдением inotify - снимаем явно
+    for (auto it = directories_.begin(); it != directories_.end();) {
+        if (inside(it->second.path.string())) {
+            ::inotify_rm_watch(inotify_fd_, it->first);
+            it = directories_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::vector<std::string> gone;
+    for (const auto& file : files_) {
+        if (inside(file.first)) {
+            gone.push_back(file.first);
+        }
+    }
+    for (const std::string& file : gone) {
+        remove_file(file);
+    }
+}
+
+void Watcher::remove_file(const std::string& path) {
+    auto it = files_.find(path);
+    if (it == files_.end()) {
+        return;
+    }
+    uintmax_t size = it->second.size;
+    uint32_t id = it->second.id;
+    auto same_size = sizes_.find(size);
+    if (same_size != sizes_.end()) {
+        std::vector<FileRecord>& records = same_size->second;
+        records.erase(std::remove_if(records.begin(), records.end(),
+                                     [id](const FileRecord& record) { return record.id == id; }),
+                      records.end());
+        if (records.empty()) {
+            sizes_.erase(same_size);
+        }
+    }
+    dirty_sizes_.insert(size);
+    files_.erase(it);
+}
+
+void Watcher::insert_file(const FileRecord& record, const std::string& path) {
+    files_[path] = record;
+    file_ids_[path] = record.id;
+    sizes_[record.size].push_back(record);
+    dirty_sizes_.insert(record.size);
+}
+
+void Watcher::rebuild() {
+    for (const auto& directory : directories_) {
+        ::inotify_rm_watch(inotify_fd_, directory.first);
+    }
+    directories_.clear();
+    files_.clear();
+    sizes_.clear();
+    groups_.clear();
+    dirty_files_.clear();
+    dirty_sizes_.clear();
+    file_ids_.clear();
+    directory_ids_.clear();
+    // Все прежние номера путей выходят из употребления вместе с индексом
+    scanner_.paths().clear();
+
+    // Подписка на директорию идёт до чтения её содержимого: изменения во
+    // время сканирования придут событиями
+    std::vector<FileRecord> records = scanner_.scan_directories(roots_);
+    const PathStore& paths = scanner_.paths();
+    for (const FileRecord& record : records) {
+        insert_file(record, paths.path(record.id).string());
+    }
+    refresh();
+}
+
+bool Watcher::paths_outgrown() const {
+    // Запас, чтобы небольшое дерево не пересканировалось после каждой правки
+    const size_t slack = 4096;
+    const PathStore& paths = scanner_.paths();
+    return paths.file_count() > 2 * files_.size() + slack ||
+           paths.directory_count() > 2 * directories_.size() + slack;
+}
+
+void Watcher::read_events() {
+    alignas(inotify_event) char buffer[64 * 1024];
+    bool overflow = false;
+
+    while (true) {
+        ssize_t length = ::read(inotify_fd_, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            break;  // EAGAIN - очередь разобрана
+        }
+        for (char* p = buffer; p < buffer + length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+            auto it = directories_.find(event->wd);
+            if (it == directories_.end()) {
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                directories_.erase(it);  // Директория удалена или снята с наблюдения
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+            const Directory parent = it->second;
+            std::string name(event->name);
+            boost::filesystem::path path = parent.path / name;
+
+            if (!(event->mask & IN_ISDIR)) {
+                dirty_files_[path.string()] = parent.id;
+                continue;
+            }
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                forget_directory(path);
+            }
+            if ((event->mask & (IN_CREATE | IN_MOVED_TO)) &&
+                scanner_.accepts_directory(path, parent.depth + 1)) {
+                // Новое поддерево сканируется сразу, его файлы уже прошли stat
+                PathStore& paths = scanner_.paths();
+                auto known = directory_ids_.find(path.string());
+                uint32_t id = known != directory_ids_.end() ? known->second
+                                                            : paths.add_directory(parent.id, name);
+                directory_ids_[path.string()] = id;
+                scanner_.scan_subtree(path, id, parent.depth + 1, [&](FileRecord&& record) {
+                    std::string file = paths.path(record.id).string();
+                    remove_file(file);
+                    dirty_files_.erase(file);
+                    insert_file(record, file);
+                });
+            }
+        }
+    }
+
+    if (overflow) {
+        // Часть событий потеряна - индекс строится заново
+        std::cerr << "Warning: inotify queue overflowed, rescanning" << std::endl;
+        rebuild();
+    } else if (paths_outgrown()) {
+        // Хранилище путей только растёт - сжимаем его полным пересканированием
+        rebuild();
+    }
+}
+
+void Watcher::refresh() {
+    PathStore& paths = scanner_.paths();
+    for (const auto& dirty : dirty_files_) {
+        const std::string& file = dirty.first;
+        // Путь уже встречался (в том числе удалённым) - его номер в PathStore
+        // переиспользуется
+        auto known = file_ids_.find(file);
+        remove_file(file);
+
+        boost::filesystem::path path(file);
+        boost::system::error_code ec;
+        if (!boost::filesystem::is_regular_file(path, ec)) {
+            continue;
+        }
+        FileRecord record;
+        std::string name = path.filename().string();
+        if (!record.stat(path) || !scanner_.accepts_file(name, record.size)) {
+            continue;
+        }
+        record.id = known != file_ids_.end() ? known->second : paths.add_file(dirty.second, name);
+        insert_file(record, file);
+    }
+    dirty_files_.clear();
+
+    if (dirty_sizes_.empty()) {
+        return;
+    }
+
+    // Заново разбиваются только группы изменившихся размеров; файлы в
+    // порядке путей, как после параллельного сканирования
+    std::vector<FileRecord> candidates;
+    for (uintmax_t size : dirty_sizes_) {
+        groups_.erase(size);
+        auto it = sizes_.find(size);
+        if (it != sizes_.end() && it->second.size() > 1) {
+            size_t first = candidates.size();
+            candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+            std::sort(candidates.begin() + static_cast<std::ptrdiff_t>(first), candidates.end(),
+                      [&paths](const FileRecord& a, const FileRecord& b) {
+                          return paths.less(a.id, b.id);
+                      });
+        }
+    }
+    dirty_sizes_.clear();
+
+    SizeGroups size_groups = SizeGroups::build(std::move(candidates));
+    hash_.find_real_duplicates_lazy(size_groups, paths, [this](DuplicateGroup&& group) {
+        groups_[group.size].push_back(std::move(group));
+    });
+}
+
+void Watcher::serve_query() {
+    int client = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0) {
+        return;
+    }
+    // Медленный клиент не должен останавливать наблюдение надолго
+    timeval timeout{5, 0};
+    ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char c = 0;
+    while (request.size() < 64 && ::recv(client, &c, 1, 0) == 1 && c != '\n') {
+        request += c;
+    }
+
+    std::ostringstream response;
+    try {
+        OutputFormat format = request.empty() ? default_format_ : ReportWriter::parse_format(request);
+        refresh();
+        ReportWriter report(response, format);
+        for (const auto& same_size : groups_) {
+            for (const DuplicateGroup& group : same_size.second) {
+                report.write(group);
+            }
+        }
+        report.finish();
+        if (format == OutputFormat::text) {
+            response << "Found " << report.groups() << " group(s) of duplicates, "
+                     << report.files() << " file(s), " << report.reclaimable_bytes()
+                     << " byte(s) reclaimable.\n";
+        }
+    } catch (const std::exception& e) {
+        response.str("");
+        response << "Error: " << e.what() << "\n";
+    }
+    send_all(client, response.str());
+    ::close(client);
+}
+
+void Watcher::run(std::ostream& progress) {
+    // Без SA_RESTART: сигнал прерывает poll, и цикл завершается
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stop;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+
+    rebuild();
+    size_t group_count = 0;
+    for (const auto& same_size : groups_) {
+        group_count += same_size.second.size();
+    }
+    progress << "Watching " << files_.size() << " file(s) in " << directories_.size()
+             << " directory(ies), " << group_count << " group(s) of duplicates; queries on "
+             << socket_path_ << std::endl;
+
+    while (!stop_requested) {
+        pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {listen_fd_, POLLIN, 0}};
+        int ready = ::poll(fds, 2, dirty_files_.empty() ? -1 : quiet_period_ms);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(system_error("poll failed"));
+        }
+        if (ready == 0) {
+            refresh();
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            read_events();
+            if (dirty_files_.size() >= max_dirty_files) {
+                refresh();
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            serve_query();
+        }
+    }
+    progress << "Stopped watching." << std::endl;
+}
+
+void Watcher::query(const std::string& socket_path, const std::string& format, std::ostream& out) {
+    if (!format.empty()) {
+        ReportWriter::parse_format(format);  // Неизвестный формат - ошибка до подключения
+    }
+    sockaddr_un address = socket_address(socket_path);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::string error = system_error("Cannot connect to watcher at " + socket_path);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::runtime_error(error);
+    }
+    send_all(fd, format + "\n");
+    ::shutdown(fd, SHUT_WR);
+
+    char buffer[64 * 1024];
+    while (true) {
+        ssize_t count = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        out.write(buffer, count);
+    }
+    ::close(fd);
+    out.flush();
+}
+
+#else
+
+Watcher::Watcher(ScannerDirectory& scanner, Hash& hash, const std::vector<std::string>& roots,
+                 const std::string& socket_path, OutputFormat default_format)
+    : scanner_(scanner), hash_(hash), roots_(roots), socket_path_(socket_path),
+      default_format_(default_format), inotify_fd_(-1), listen_fd_(-1) {
+    throw std::runtime_error("Watch mode requires Linux (inotify)");
+}
+
+Watcher::~Watcher() {}
+
+void Watcher::run(std::ostream&) {}
+
+void Watcher::query(const std::string&, const std::string&, std::ostream&) {
+    throw std::runtime_error("Watch mode requires Linux (inotify)");
+}
+
+#endif
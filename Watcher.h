@@ -0,0 +1,111 @@
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "DuplicateGroup.h"
+#include "FileRecord.h"
+#include "ReportWriter.h"
+
+class ScannerDirectory;
+class Hash;
+
+// Режим наблюдения (--watch): индекс дубликатов строится один раз и
+// поддерживается по событиям inotify (Linux).
+//
+// Индекс - файлы по размеру и подтверждённые группы по размеру. Созданный,
+// изменённый или удалённый файл заново проверяется через stat, а его
+// старый и новый размеры помечаются изменившимися. Перед ответом на запрос
+// (и после короткой паузы без событий) заново разбиваются только группы
+// изменившихся размеров; хеши неизменных файлов Hash берёт из кэша блоков,
+// так что читаются лишь изменившиеся файлы.
+//
+// Запросы принимаются на локальном Unix-сокете: клиент присылает строку
+// с форматом отчёта (пустая - формат по умолчанию) и получает отчёт о
+// текущих группах. Клиент - Watcher::query (bayan --query).
+class Watcher {
+private:
+    // Наблюдаемая директория: путь, номер в PathStore сканера и глубина
+    struct Directory {
+        boost::filesystem::path path;
+        uint32_t id;
+        int depth;
+    };
+
+    ScannerDirectory& scanner_;
+    Hash& hash_;
+    std::vector<std::string> roots_;
+    std::string socket_path_;
+    OutputFormat default_format_;
+
+    int inotify_fd_;
+    int listen_fd_;
+
+    std::mutex directories_mutex_;                          // Директории добавляются и потоками обхода
+    std::unordered_map<int, Directory> directories_;        // Дескриптор inotify -> директория
+
+    std::unordered_map<std::string, FileRecord> files_;     // Путь -> файл индекса
+    std::map<uintmax_t, std::vector<FileRecord>> sizes_;    // Размер -> файлы этого размера
+    std::map<uintmax_t, std::vector<DuplicateGroup>> groups_;   // Размер -> подтверждённые группы
+
+    std::map<std::string, uint32_t> dirty_files_;           // Путь -> номер директории в PathStore
+    std::set<uintmax_t> dirty_sizes_;
+
+    // Номера путей в PathStore сканера. Хранилище только растёт, поэтому
+    // номер пути переживает удаление файла и переиспользуется, когда путь
+    // появляется снова; оба словаря сбрасываются вместе с хранилищем в rebuild
+    std::unordered_map<std::string, uint32_t> file_ids_;
+    std::unordered_map<std::string, uint32_t> directory_ids_;
+
+    // Подписаться на директорию (из потоков обхода в том числе)
+    void watch_directory(const boost::filesystem::path& path, uint32_t id, int depth);
+
+    // Снять наблюдение с директории и вложенных в неё; их файлы - на проверку
+    void forget_directory(const boost::filesystem::path& path);
+
+    // Полное сканирование корней и разбиение всех групп; PathStore сканера
+    // перед ним очищается
+    void rebuild();
+
+    // В PathStore накопилось намного больше путей, чем в индексе
+    // (файлы с новыми именами, перемещённые поддеревья) - пора пересканировать
+    bool paths_outgrown() const;
+
+    // Разобрать накопленные события inotify
+    void read_events();
+
+    // Применить изменения: stat изменившихся файлов, разбиение групп
+    // изменившихся размеров
+    void refresh();
+
+    // Ответить клиенту, подключившемуся к сокету
+    void serve_query();
+
+    void remove_file(const std::string& path);
+    void insert_file(const FileRecord& record, const std::string& path);
+
+public:
+    Watcher(ScannerDirectory& scanner, Hash& hash, const std::vector<std::string>& roots,
+            const std::string& socket_path, OutputFormat default_format = OutputFormat::text);
+    ~Watcher();
+
+    Watcher(const Watcher&) = delete;
+    Watcher& operator=(const Watcher&) = delete;
+
+    // Построить индекс и обслуживать события и запросы до SIGINT или SIGTERM;
+    // ход работы - в progress
+    void run(std::ostream& progress);
+
+    // Запросить отчёт у работающего наблюдателя и вывести его в out
+    // (format - имя формата, пустое - формат наблюдателя)
+    static void query(const std::string& socket_path, const std::string& format, std::ostream& out);
+
+    size_t file_count() const { return files_.size(); }
+    size_t directory_count() const { return directories_.size(); }
+};
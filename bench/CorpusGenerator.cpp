@@ -0,0 +1,167 @@
+#include "CorpusGenerator.h"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+CorpusConfig::CorpusConfig()
+    : seed(42),
+      near_duplicates(400), near_duplicate_size(256 * 1024),
+      late_diverging(16), late_diverging_size(16 * 1024 * 1024),
+      hardlink_files(200), hardlinks_per_file(8), hardlink_file_size(64 * 1024),
+      nesting_depth(64), nested_file_size(4096),
+      tiny_files(20000) {}
+
+void CorpusConfig::scale(double factor) {
+    auto scaled = [factor](size_t value) {
+        return static_cast<size_t>(static_cast<double>(value) * factor);
+    };
+    near_duplicates = scaled(near_duplicates);
+    late_diverging = scaled(late_diverging);
+    hardlink_files = scaled(hardlink_files);
+    nesting_depth = scaled(nesting_depth);
+    tiny_files = scaled(tiny_files);
+}
+
+CorpusGenerator::CorpusGenerator(const boost::filesystem::path& root, const CorpusConfig& config)
+    : config_(config), root_(root), stats_(), state_(config.seed ? config.seed : 1) {}
+
+uint64_t CorpusGenerator::next() {
+    // xorshift64*: воспроизводимое содержимое при одинаковом seed
+    state_ ^= state_ >> 12;
+    state_ ^= state_ << 25;
+    state_ ^= state_ >> 27;
+    return state_ * 0x2545F4914F6CDD1DULL;
+}
+
+void CorpusGenerator::fill(std::string& buffer, size_t size) {
+    buffer.resize(size);
+    for (size_t i = 0; i < size; i += 8) {
+        uint64_t value = next();
+        size_t count = std::min<size_t>(8, size - i);
+        for (size_t j = 0; j < count; ++j) {
+            buffer[i + j] = static_cast<char>(value >> (j * 8));
+        }
+    }
+}
+
+void CorpusGenerator::write_file(const boost::filesystem::path& path, const std::string& data) {
+    std::ofstream out(path.string(), std::ios::binary | std::ios::trunc);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!out) {
+        throw std::runtime_error("Cannot write " + path.string());
+    }
+    ++stats_.files;
+    stats_.bytes += data.size();
+}
+
+void CorpusGenerator::make_directory(const boost::filesystem::path& path) {
+    if (boost::filesystem::create_directories(path)) {
+        ++stats_.directories;
+    }
+}
+
+void CorpusGenerator::generate_near_duplicates() {
+    if (config_.near_duplicates == 0 || config_.near_duplicate_size == 0) {
+        return;
+    }
+    boost::filesystem::path dir = root_ / "near";
+    make_directory(dir);
+    std::string base;
+    fill(base, config_.near_duplicate_size);
+    std::string data;
+    for (size_t i = 0; i < config_.near_duplicates; ++i) {
+        data = base;
+        if (i % 4 != 0) {
+            data[next() % data.size()] ^= 0x5a;
+        }
+        write_file(dir / ("n" + std::to_string(i) + ".bin"), data);
+    }
+}
+
+void CorpusGenerator::generate_late_diverging() {
+    if (config_.late_diverging == 0 || config_.late_diverging_size == 0) {
+        return;
+    }
+    boost::filesystem::path dir = root_ / "late";
+    make_directory(dir);
+    std::string data;
+    fill(data, config_.late_diverging_size);
+    for (size_t i = 0; i < config_.late_diverging; ++i) {
+        // Соседние файлы пары совпадают, пары различаются последним байтом
+        data.back() = static_cast<char>(i / 2);
+        write_file(dir / ("l" + std::to_string(i) + ".img"), data);
+    }
+}
+
+void CorpusGenerator::generate_hardlinks() {
+    if (config_.hardlink_files == 0 || config_.hardlink_file_size == 0) {
+        return;
+    }
+    boost::filesystem::path dir = root_ / "links";
+    make_directory(dir / "farm");
+    std::string data;
+    for (size_t i = 0; i < config_.hardlink_files; ++i) {
+        fill(data, config_.hardlink_file_size);
+        boost::filesystem::path original = dir / ("f" + std::to_string(i));
+        write_file(original, data);
+        for (size_t link = 0; link < config_.hardlinks_per_file; ++link) {
+            boost::filesystem::path target =
+                dir / "farm" / ("f" + std::to_string(i) + "_" + std::to_string(link));
+            boost::system::error_code ec;
+            boost::filesystem::create_hard_link(original, target, ec);
+            if (ec) {
+                write_file(target, data);  // Файловая система без жёстких ссылок
+            } else {
+                ++stats_.files;
+            }
+        }
+    }
+}
+
+void CorpusGenerator::generate_deep_nesting() {
+    if (config_.nesting_depth == 0) {
+        return;
+    }
+    boost::filesystem::path dir = root_ / "deep";
+    std::string data;
+    fill(data, config_.nested_file_size);
+    for (size_t level = 0; level < config_.nesting_depth; ++level) {
+        dir /= "d" + std::to_string(level);
+        make_directory(dir);
+        // Каждый второй уровень повторяет содержимое предыдущего
+        if (level % 2 == 0) {
+            fill(data, config_.nested_file_size);
+        }
+        write_file(dir / "file.dat", data);
+    }
+}
+
+void CorpusGenerator::generate_tiny_files() {
+    if (config_.tiny_files == 0) {
+        return;
+    }
+    const size_t files_per_directory = 1000;
+    boost::filesystem::path dir;
+    std::string data;
+    for (size_t i = 0; i < config_.tiny_files; ++i) {
+        if (i % files_per_directory == 0) {
+            dir = root_ / "tiny" / ("t" + std::to_string(i / files_per_directory));
+            make_directory(dir);
+        }
+        // Мало различных размеров и содержимого - много групп кандидатов
+        size_t size = 1 + next() % 64;
+        data.assign(size, static_cast<char>('a' + next() % 4));
+        write_file(dir / ("x" + std::to_string(i)), data);
+    }
+}
+
+CorpusStats CorpusGenerator::generate() {
+    stats_ = CorpusStats();
+    make_directory(root_);
+    generate_near_duplicates();
+    generate_late_diverging();
+    generate_hardlinks();
+    generate_deep_nesting();
+    generate_tiny_files();
+    return stats_;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Генератор синтетического дерева файлов для бенчмарков.
+// Каждый раздел воспроизводит тип нагрузки, на котором bayan ведёт себя
+// по-разному; нулевое количество отключает раздел.
+struct CorpusConfig {
+    uint64_t seed;
+
+    size_t near_duplicates;         // near/: файлы одного размера, отличающиеся одним байтом
+    size_t near_duplicate_size;     //   (каждый четвёртый - точная копия)
+
+    size_t late_diverging;          // late/: большие файлы, различающиеся только в последнем блоке
+    size_t late_diverging_size;     //   (парами совпадающие)
+
+    size_t hardlink_files;          // links/: исходные файлы
+    size_t hardlinks_per_file;      //   и жёсткие ссылки на каждый
+    size_t hardlink_file_size;
+
+    size_t nesting_depth;           // deep/: цепочка вложенных директорий с файлом на каждом уровне
+    size_t nested_file_size;
+
+    size_t tiny_files;              // tiny/: множество файлов 1..64 байт по 1000 в директории
+
+    CorpusConfig();
+
+    // Все количества умножаются на scale (размеры файлов не меняются)
+    void scale(double factor);
+};
+
+// Итог генерации
+struct CorpusStats {
+    size_t files;                   // Записей в директориях (включая жёсткие ссылки)
+    size_t directories;
+    uintmax_t bytes;                // Байт записано на диск
+
+    CorpusStats() : files(0), directories(0), bytes(0) {}
+};
+
+class CorpusGenerator {
+private:
+    CorpusConfig config_;
+    boost::filesystem::path root_;
+    CorpusStats stats_;
+    uint64_t state_;                // Состояние генератора xorshift
+
+    uint64_t next();
+    void fill(std::string& buffer, size_t size);
+    void write_file(const boost::filesystem::path& path, const std::string& data);
+    void make_directory(const boost::filesystem::path& path);
+
+    void generate_near_duplicates();
+    void generate_late_diverging();
+    void generate_hardlinks();
+    void generate_deep_nesting();
+    void generate_tiny_files();
+
+public:
+    CorpusGenerator(const boost::filesystem::path& root, const CorpusConfig& config);
+
+    // Создать дерево в root (директория создаётся при необходимости).
+    // Ошибки файловой системы - исключения boost::filesystem.
+    CorpusStats generate();
+};
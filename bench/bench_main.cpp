@@ -0,0 +1,311 @@
+#include "CorpusGenerator.h"
+#include "Hash.h"
+#include "Hasher.h"
+#include "ScanDir.h"
+#include "SizeGroups.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace po = boost::program_options;
+
+// Подсчёт выделений памяти: глобальные operator new/delete бенчмарка.
+// Встроенный в код библиотеки free() рядом со стандартным operator new
+// GCC принимает за несовпадение выделения и освобождения - не встраиваем.
+#if defined(__GNUC__) || defined(__clang__)
+#define BAYAN_NOINLINE __attribute__((noinline))
+#else
+#define BAYAN_NOINLINE
+#endif
+
+namespace {
+    std::atomic<size_t> allocation_count(0);
+    std::atomic<size_t> allocation_bytes(0);
+}
+
+BAYAN_NOINLINE void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+BAYAN_NOINLINE void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+BAYAN_NOINLINE void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+// Доступ к внутренним методам Hash (объявлен другом в Hash.h)
+class HashBenchmark {
+public:
+    // Хеши всех блоков каждого файла групп через get_block_hash; возвращает байты
+    static uintmax_t hash_all_blocks(Hash& hash, const SizeGroups& groups, const PathStore& paths) {
+        uintmax_t bytes = 0;
+        uint8_t digest[Hasher::max_digest_size];
+        for (size_t g = 0; g < groups.size(); ++g) {
+            for (const FileRecord& file : groups[g]) {
+                Hash::FileHandle handle(file, hash.read_options, paths);
+                size_t blocks = static_cast<size_t>((file.size + hash.block_size - 1) / hash.block_size);
+                for (size_t block = 0; block < blocks; ++block) {
+                    if (!hash.get_block_hash(handle, block, digest)) {
+                        break;
+                    }
+                }
+                bytes += file.size;
+            }
+        }
+        return bytes;
+    }
+
+    // Сравнение соседних файлов каждой группы через compare_handles_from_block;
+    // возвращает номинальный объём (оба файла целиком)
+    static uintmax_t compare_neighbours(Hash& hash, const SizeGroups& groups, const PathStore& paths) {
+        uintmax_t bytes = 0;
+        for (size_t g = 0; g < groups.size(); ++g) {
+            SizeGroups::Span group = groups[g];
+            for (size_t i = 1; i < group.size(); ++i) {
+                Hash::FileHandle first(group[i - 1], hash.read_options, paths);
+                Hash::FileHandle second(group[i], hash.read_options, paths);
+                hash.compare_handles_from_block(first, second);
+                bytes += group[i].size * 2;
+            }
+        }
+        return bytes;
+    }
+};
+
+namespace {
+    struct Measurement {
+        size_t items;
+        uintmax_t bytes;
+    };
+
+    void print_header() {
+        std::printf("%-22s %10s %10s %9s %12s %10s %12s %10s\n", "benchmark", "files", "MB",
+                    "seconds", "files/s", "MB/s", "allocs", "alloc MB");
+    }
+
+    // Выполнить body и напечатать пропускную способность и выделения памяти
+    template <typename Body>
+    void run_benchmark(const char* name, Body body) {
+        size_t count_before = allocation_count.load();
+        size_t bytes_before = allocation_bytes.load();
+        auto start = std::chrono::steady_clock::now();
+        Measurement result = body();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        size_t allocations = allocation_count.load() - count_before;
+        size_t allocated = allocation_bytes.load() - bytes_before;
+
+        double megabytes = static_cast<double>(result.bytes) / (1024.0 * 1024.0);
+        double safe_seconds = seconds > 0 ? seconds : 1e-9;
+        std::printf("%-22s %10zu %10.1f %9.3f %12.0f %10.1f %12zu %10.1f\n", name, result.items,
+                    megabytes, seconds, static_cast<double>(result.items) / safe_seconds,
+                    megabytes / safe_seconds, allocations,
+                    static_cast<double>(allocated) / (1024.0 * 1024.0));
+    }
+
+    // На время жизни понижает мягкий предел открытых файлов процесса до limit:
+    // превышение --max-open-files тогда проявляется как EMFILE
+    class DescriptorLimit {
+    public:
+        explicit DescriptorLimit(size_t limit) : changed_(false) {
+#if defined(__unix__) || defined(__APPLE__)
+            if (getrlimit(RLIMIT_NOFILE, &saved_) == 0 && saved_.rlim_cur > static_cast<rlim_t>(limit)) {
+                struct rlimit lowered = saved_;
+                lowered.rlim_cur = static_cast<rlim_t>(limit);
+                changed_ = setrlimit(RLIMIT_NOFILE, &lowered) == 0;
+            }
+#else
+            (void)limit;
+#endif
+        }
+        ~DescriptorLimit() {
+#if defined(__unix__) || defined(__APPLE__)
+            if (changed_) {
+                setrlimit(RLIMIT_NOFILE, &saved_);
+            }
+#endif
+        }
+        DescriptorLimit(const DescriptorLimit&) = delete;
+        DescriptorLimit& operator=(const DescriptorLimit&) = delete;
+
+    private:
+        bool changed_;
+#if defined(__unix__) || defined(__APPLE__)
+        struct rlimit saved_;
+#endif
+    };
+
+    // Удаляет временное дерево при любом выходе из main, в том числе по исключению
+    class CorpusGuard {
+    public:
+        CorpusGuard(const boost::filesystem::path& corpus, bool remove)
+            : corpus_(corpus), remove_(remove) {}
+        ~CorpusGuard() {
+            if (remove_) {
+                boost::system::error_code ec;
+                boost::filesystem::remove_all(corpus_, ec);
+            }
+        }
+        CorpusGuard(const CorpusGuard&) = delete;
+        CorpusGuard& operator=(const CorpusGuard&) = delete;
+
+    private:
+        boost::filesystem::path corpus_;
+        bool remove_;
+    };
+
+    size_t count_files(const SizeGroups& groups) {
+        size_t files = 0;
+        for (size_t g = 0; g < groups.size(); ++g) {
+            files += groups[g].size();
+        }
+        return files;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        po::options_description desc("bayan_bench - corpus generator and microbenchmarks");
+        desc.add_options()
+            ("help,h", "Show help message")
+            ("corpus,c", po::value<std::string>(),
+                "Corpus directory (generated if missing; default: temporary, removed afterwards)")
+            ("generate-only", po::bool_switch(), "Only generate the corpus")
+            ("keep", po::bool_switch(), "Keep the temporary corpus")
+            ("scale", po::value<double>()->default_value(1.0), "Multiply all corpus counts")
+            ("tiny-files", po::value<size_t>(), "Number of tiny files")
+            ("nesting-depth", po::value<size_t>(), "Depth of the nested directory chain")
+            ("seed", po::value<uint64_t>()->default_value(42), "Corpus content seed")
+            ("threads,t", po::value<size_t>()->default_value(1), "Worker threads (0 = all cores)")
+            ("block-size,b", po::value<size_t>()->default_value(4096), "Block size in bytes")
+            ("hash,H", po::value<std::string>()->default_value("crc32"),
+                "Hash algorithm (crc32|crc32c|xxhash64|md5|sha256)")
+            ("io", po::value<std::string>(), "File read mode (stream|pread|mmap)");
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help")) {
+            std::cout << desc << std::endl;
+            return 0;
+        }
+        po::notify(vm);
+
+        CorpusConfig config;
+        config.seed = vm["seed"].as<uint64_t>();
+        config.scale(vm["scale"].as<double>());
+        if (vm.count("tiny-files")) {
+            config.tiny_files = vm["tiny-files"].as<size_t>();
+        }
+        if (vm.count("nesting-depth")) {
+            config.nesting_depth = vm["nesting-depth"].as<size_t>();
+        }
+
+        bool temporary = !vm.count("corpus");
+        boost::filesystem::path corpus = temporary
+            ? boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("bayan-bench-%%%%-%%%%")
+            : boost::filesystem::path(vm["corpus"].as<std::string>());
+
+        // Только что сгенерированное по --generate-only дерево остаётся
+        CorpusGuard corpus_guard(corpus, temporary && !vm["keep"].as<bool>() &&
+                                             !vm["generate-only"].as<bool>());
+
+        if (!boost::filesystem::exists(corpus)) {
+            std::cout << "Generating corpus in " << corpus.string() << "..." << std::endl;
+            auto start = std::chrono::steady_clock::now();
+            CorpusStats stats = CorpusGenerator(corpus, config).generate();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "Generated " << stats.files << " file(s), " << stats.directories
+                      << " director(ies), " << stats.bytes / (1024 * 1024) << " MB in "
+                      << seconds << " s." << std::endl;
+        }
+        if (vm["generate-only"].as<bool>()) {
+            return 0;
+        }
+
+        size_t threads = vm["threads"].as<size_t>();
+        size_t block_size = vm["block-size"].as<size_t>();
+        std::unique_ptr<Hasher> hasher = Hasher::create(vm["hash"].as<std::string>());
+        ReadOptions read_options;
+        if (vm.count("io")) {
+            read_options.mode = ReadOptions::parse_mode(vm["io"].as<std::string>());
+        }
+
+        // Файлы только что записаны или уже читались - результаты для горячего кэша
+        std::cout << "Benchmarks (" << hasher->name() << ", block " << block_size << ", "
+                  << threads << " thread(s)):" << std::endl;
+        print_header();
+
+        ScannerDirectory scanner(-1, 1, {}, {}, threads);
+        std::vector<FileRecord> files;
+        run_benchmark("scan", [&]() {
+            files = scanner.scan_directories({corpus.string()});
+            return Measurement{files.size(), 0};
+        });
+
+        SizeGroups groups;
+        std::vector<FileRecord> input(files);
+        run_benchmark("size grouping", [&]() {
+            groups = SizeGroups::build(std::move(input));
+            return Measurement{files.size(), 0};
+        });
+        size_t candidates = count_files(groups);
+
+        Hash sequential(block_size, *hasher, 1, nullptr, read_options);
+        run_benchmark("get_block_hash", [&]() {
+            return Measurement{candidates, HashBenchmark::hash_all_blocks(sequential, groups, scanner.paths())};
+        });
+        run_benchmark("compare_from_block", [&]() {
+            return Measurement{candidates, HashBenchmark::compare_neighbours(sequential, groups, scanner.paths())};
+        });
+
+        uintmax_t group_bytes = 0;
+        for (size_t g = 0; g < groups.size(); ++g) {
+            group_bytes += groups[g][0].size * groups[g].size();
+        }
+        Hash hash(block_size, *hasher, threads, nullptr, read_options);
+        std::vector<std::vector<boost::filesystem::path>> found;
+        run_benchmark("find_duplicates", [&]() {
+            found = hash.find_real_duplicates_lazy(groups, scanner.paths());
+            return Measurement{candidates, group_bytes};
+        });
+
+        // --verify при узких пределах дескрипторов и памяти: файлы группы
+        // читаются с вытеснением, но ни один не должен выпасть из неё.
+        // Предел процесса понижен, чтобы лишние открытые файлы не прошли незамеченными.
+        ReadOptions limited = read_options;
+        limited.max_open_files = 8;
+        limited.memory_limit = 1024 * 1024;
+        Hash verifying(block_size, *hasher, threads, nullptr, limited, 3, true, nullptr, true);
+        std::vector<std::vector<boost::filesystem::path>> verified;
+        run_benchmark("find_duplicates_verify", [&]() {
+            DescriptorLimit descriptor_limit(64);
+            verified = verifying.find_real_duplicates_lazy(groups, scanner.paths());
+            return Measurement{candidates, group_bytes};
+        });
+        if (verified != found) {
+            throw std::runtime_error("--verify with --max-open-files 8 --memory-limit 1M "
+                                     "found different duplicate groups");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,7 +1,16 @@
 #include "ScanDir.h"
 #include "Hash.h"
+#include "BlockCache.h"
+#include "Pipeline.h"
+#include "Stats.h"
+#include "ReportWriter.h"
+#include "Deduplicator.h"
+#include "Watcher.h"
+#include <fstream>
 #include <iostream>
 #include <vector>
+#include <memory>
+#include <stdexcept>
 #include <boost/program_options.hpp>
 
 namespace po = boost::program_options;
@@ -25,7 +34,49 @@ int main(int argc, char* argv[]) {
             ("block-size,b", po::value<size_t>()->default_value(4096),
                 "Block size for reading files in bytes")
             ("hash,H", po::value<std::string>()->default_value("crc32"),
-                 "Hash algorithm (crc32)");
+                 "Hash algorithm (crc32|crc32c|xxhash64|md5|sha256)")
+            ("threads,t", po::value<size_t>()->default_value(1),
+                "Worker threads for content comparison (0 = all cores)")
+            ("scan-threads,T", po::value<size_t>()->default_value(1),
+                "Worker threads for directory scanning (0 = all cores)")
+            ("cache,C", po::value<std::string>(),
+                "File with block hashes kept between runs")
+            ("io", po::value<std::string>(),
+                "File read mode (stream|pread|mmap, default pread where available)")
+            ("read-size", po::value<size_t>()->default_value(ReadOptions().read_size),
+                "Bytes fetched per read call (several blocks at once)")
+            ("async", po::value<std::string>()->default_value("none"),
+                "Batched block reads for pread mode (none|threads|uring|auto)")
+            ("queue-depth", po::value<size_t>()->default_value(ReadOptions().queue_depth),
+                "Reads kept in flight by --async across all threads")
+            ("max-open-files", po::value<size_t>()->default_value(ReadOptions().max_open_files),
+                "Descriptors kept open for comparison across all threads")
+            ("memory-limit", po::value<std::string>(),
+                "Memory for read windows and block hashes across all threads (e.g. 256M, default unlimited)")
+            ("samples", po::value<size_t>()->default_value(3),
+                "Interior blocks sampled (with the first and last) before the full pass, 0 = off")
+            ("pipeline", po::bool_switch(),
+                "Group by size and read candidates while the directory walk is still running")
+            ("hardlinks", po::value<std::string>()->default_value("report"),
+                "Paths to the same inode: report all of them or suppress all but one (report|suppress)")
+            ("verify", po::bool_switch(),
+                "Also compare block contents byte by byte, ruling out hash collisions (implied by --action)")
+            ("format,f", po::value<std::string>()->default_value("text"),
+                "Duplicate report format (text|jsonl|nul|csv)")
+            ("output,o", po::value<std::string>(),
+                "Write the duplicate report to a file instead of stdout")
+            ("action", po::value<std::string>(),
+                "Reclaim space: keep the first file of each group and replace the rest (hardlink|reflink|delete)")
+            ("dry-run", po::bool_switch(),
+                "With --action: only report the bytes that would be saved")
+            ("watch", po::value<std::string>(),
+                "Keep running: track the included directories with inotify and serve reports on this Unix socket")
+            ("query", po::value<std::string>(),
+                "Print the current report of a --watch instance listening on this socket (in --format if given)")
+            ("stats", po::bool_switch(),
+                "Print per-phase timings and I/O counters to stderr")
+            ("stats-json", po::value<std::string>(),
+                "Write the same statistics as JSON to a file (- for stdout)");
 
         po::variables_map vm;
         po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -35,6 +86,14 @@ int main(int argc, char* argv[]) {
             return 0;
         }
 
+        // Запрос к работающему наблюдателю не требует остальных параметров
+        if (vm.count("query")) {
+            Watcher::query(vm["query"].as<std::string>(),
+                           vm["format"].defaulted() ? std::string() : vm["format"].as<std::string>(),
+                           std::cout);
+            return 0;
+        }
+
         po::notify(vm);
 
         // Получаем параметры
@@ -47,50 +106,199 @@ int main(int argc, char* argv[]) {
         int level = vm["level"].as<int>();
         size_t min_file_size = vm["min-size"].as<size_t>();
         size_t block_size = vm["block-size"].as<size_t>();
+        // Неизвестный алгоритм - ошибка до начала сканирования
+        std::unique_ptr<Hasher> hasher = Hasher::create(vm["hash"].as<std::string>());
+
+        ReadOptions read_options;
+        if (vm.count("io")) {
+            read_options.mode = ReadOptions::parse_mode(vm["io"].as<std::string>());
+        }
+        read_options.read_size = vm["read-size"].as<size_t>();
+        read_options.async = AsyncReader::parse_engine(vm["async"].as<std::string>());
+        read_options.queue_depth = vm["queue-depth"].as<size_t>();
+        read_options.max_open_files = vm["max-open-files"].as<size_t>();
+        if (read_options.max_open_files == 0) {
+            throw std::invalid_argument("--max-open-files must be at least 1");
+        }
+        if (vm.count("memory-limit")) {
+            read_options.memory_limit = ReadOptions::parse_size(vm["memory-limit"].as<std::string>());
+        }
+        std::string hardlinks = vm["hardlinks"].as<std::string>();
+        if (hardlinks != "report" && hardlinks != "suppress") {
+            throw std::invalid_argument("Unknown hardlinks mode: " + hardlinks);
+        }
+        size_t threads = vm["threads"].as<size_t>();
+        size_t scan_threads = vm["scan-threads"].as<size_t>();
         
         std::vector<std::string> masks;
         if (vm.count("mask")) {
             masks = vm["mask"].as<std::vector<std::string>>();
         }
 
+        // Отчёт о дубликатах пишется по мере нахождения групп. Если машиночитаемый
+        // отчёт идёт в stdout, сообщения о ходе работы уходят в stderr
+        OutputFormat format = ReportWriter::parse_format(vm["format"].as<std::string>());
+        std::ofstream output_file;
+        if (vm.count("output")) {
+            std::string output_path = vm["output"].as<std::string>();
+            output_file.open(output_path, std::ios::binary | std::ios::trunc);
+            if (!output_file) {
+                throw std::runtime_error("Cannot open output file " + output_path);
+            }
+        }
+        bool to_stdout = !vm.count("output");
+        std::ostream& report_stream = to_stdout ? std::cout : static_cast<std::ostream&>(output_file);
+        std::ostream& progress = (to_stdout && format != OutputFormat::text) ? std::cerr : std::cout;
+        // В режиме наблюдения отчёты уходят клиентам сокета, а не в stdout
+        bool watch = vm.count("watch") != 0;
+        if (watch && (vm.count("action") || vm.count("output") || vm["pipeline"].as<bool>())) {
+            throw std::invalid_argument("--watch cannot be combined with --action, --output or --pipeline");
+        }
+        ReportWriter report(report_stream, watch ? OutputFormat::text : format);
+
+        // Освобождение места идёт параллельно с поиском, по мере подтверждения групп
+        std::unique_ptr<Deduplicator> deduplicator;
+        if (vm.count("action")) {
+            deduplicator = std::make_unique<Deduplicator>(
+                Deduplicator::parse_action(vm["action"].as<std::string>()),
+                vm["dry-run"].as<bool>(), threads);
+        } else if (vm["dry-run"].as<bool>()) {
+            throw std::invalid_argument("--dry-run requires --action");
+        }
+
+        // Статистика собирается только по запросу: без неё счётчики не трогаются
+        std::unique_ptr<Stats> stats;
+        if (vm["stats"].as<bool>() || vm.count("stats-json")) {
+            stats = std::make_unique<Stats>();
+            read_options.stats = stats.get();
+        }
+        auto finish_reports = [&]() {
+            report.finish();
+            if (!stats) {
+                return;
+            }
+            stats->finish();
+            if (vm["stats"].as<bool>()) {
+                stats->print(std::cerr);
+            }
+            if (vm.count("stats-json")) {
+                std::string json_path = vm["stats-json"].as<std::string>();
+                if (json_path == "-") {
+                    stats->write_json(std::cout);
+                } else {
+                    std::ofstream json(json_path);
+                    stats->write_json(json);
+                    if (!json) {
+                        throw std::runtime_error("Cannot write statistics to " + json_path);
+                    }
+                }
+            }
+        };
+
+        std::unique_ptr<BlockCache> cache;
+        if (vm.count("cache")) {
+            cache = std::make_unique<BlockCache>(vm["cache"].as<std::string>(), block_size,
+                                                 hasher->name(), hasher->digest_size());
+            cache->load();
+        } else if (watch) {
+            // Хеши неизменных файлов между обновлениями индекса - только в памяти
+            cache = std::make_unique<BlockCache>(boost::filesystem::path(), block_size,
+                                                 hasher->name(), hasher->digest_size());
+        }
+        Hash hash(block_size, *hasher, threads, cache.get(), read_options,
+                  vm["samples"].as<size_t>(), hardlinks == "report", stats.get(),
+                  vm["verify"].as<bool>() || vm.count("action") != 0);
+
         // Шаг 1: Сканирование директорий
-        std::cout << "Scanning directories..." << std::endl;
-        ScannerDirectory scanner(level, min_file_size, masks, exclude_dirs);
-        auto all_files = scanner.scan_directories(include_dirs);
-        
-        if (all_files.empty()) {
-            std::cout << "No files found matching criteria." << std::endl;
+        progress << "Scanning directories..." << std::endl;
+        ScannerDirectory scanner(level, min_file_size, masks, exclude_dirs, scan_threads,
+                                 stats.get());
+
+        if (watch) {
+            Watcher watcher(scanner, hash, include_dirs, vm["watch"].as<std::string>(), format);
+            watcher.run(progress);
+            if (vm.count("cache")) {
+                cache->save();
+            }
+            finish_reports();
             return 0;
         }
-        
-        std::cout << "Found " << all_files.size() << " file(s)." << std::endl;
 
         // Шаг 2: Группировка по размеру
-        auto size_groups = scanner.get_duplicate_groups_by_size(all_files);
-        std::cout << "Found " << size_groups.size() << " group(s) of files with same size." << std::endl;
+        SizeGroups size_groups;
+        if (vm["pipeline"].as<bool>()) {
+            // Группировка и чтение кандидатов идут одновременно с обходом
+            Pipeline pipeline(scanner, hash, threads);
+            {
+                Stats::Scope timing(stats.get(), Phase::scan);
+                size_groups = pipeline.run(include_dirs);
+            }
+            if (pipeline.files_found() == 0) {
+                progress << "No files found matching criteria." << std::endl;
+                finish_reports();
+                return 0;
+            }
+            progress << "Found " << pipeline.files_found() << " file(s)." << std::endl;
+        } else {
+            std::vector<FileRecord> all_files;
+            {
+                Stats::Scope timing(stats.get(), Phase::scan);
+                all_files = scanner.scan_directories(include_dirs);
+            }
+
+            if (all_files.empty()) {
+                progress << "No files found matching criteria." << std::endl;
+                finish_reports();
+                return 0;
+            }
+
+            progress << "Found " << all_files.size() << " file(s)." << std::endl;
+            Stats::Scope timing(stats.get(), Phase::grouping);
+            size_groups = scanner.get_duplicate_groups_by_size(std::move(all_files));
+        }
+        if (stats) {
+            stats->mark_peak_rss(Phase::stat);
+        }
+        progress << "Found " << size_groups.size() << " group(s) of files with same size." << std::endl;
 
         if (size_groups.empty()) {
-            std::cout << "No potential duplicates found." << std::endl;
+            progress << "No potential duplicates found." << std::endl;
+            finish_reports();
             return 0;
         }
 
-        // Шаг 3: Поиск реальных дубликатов (с ленивым чтением)
-        std::cout << "Comparing file contents (with lazy reading)..." << std::endl;
-        Hash hash(block_size);
-        auto duplicates = hash.find_real_duplicates_lazy(size_groups);
+        // Шаг 3: Поиск реальных дубликатов (с ленивым чтением);
+        // каждая подтверждённая группа сразу уходит в отчёт
+        progress << "Comparing file contents (with lazy reading)...\n" << std::endl;
+        hash.find_real_duplicates_lazy(size_groups, scanner.paths(), [&](DuplicateGroup&& group) {
+            report.write(group);
+            if (deduplicator) {
+                deduplicator->submit(std::move(group));
+            }
+        });
+        if (cache) {
+            cache->save();
+        }
 
-        // Шаг 4: Вывод результатов
-        if (duplicates.empty()) {
-            std::cout << "No duplicates found." << std::endl;
+        // Шаг 4: Итоги
+        if (report.groups() == 0) {
+            progress << "No duplicates found." << std::endl;
         } else {
-            std::cout << "\nFound " << duplicates.size() << " group(s) of duplicates:\n" << std::endl;
-            for (const auto& group : duplicates) {
-                for (const auto& file : group) {
-                    std::cout << file.string() << std::endl;
-                }
-                std::cout << std::endl;
-            }
+            report.finish();
+            progress << "Found " << report.groups() << " group(s) of duplicates, "
+                     << report.files() << " file(s), " << report.reclaimable_bytes()
+                     << " byte(s) reclaimable." << std::endl;
+        }
+        if (deduplicator) {
+            deduplicator->finish();
+            progress << (vm["dry-run"].as<bool>() ? "Dry run: " : "") << vm["action"].as<std::string>()
+                     << " - " << deduplicator->replaced() << " file(s) "
+                     << (vm["dry-run"].as<bool>() ? "would be processed" : "processed") << ", "
+                     << deduplicator->skipped() << " skipped, " << deduplicator->saved_bytes()
+                     << " byte(s) " << (vm["dry-run"].as<bool>() ? "would be saved." : "saved.")
+                     << std::endl;
         }
+        finish_reports();
 
     } catch (const po::required_option& e) {
         std::cerr << "Error: " << e.what() << std::endl;